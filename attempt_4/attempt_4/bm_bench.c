@@ -0,0 +1,105 @@
+// bm_bench.c  —  userspace microbenchmarks of the vmsort_bm.h hot paths
+// built against shim/ (make bench): no root, no module, no kernel headers
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "vmsort_bm.h"
+
+#define REPS_MIN_NS 20000000ULL         /* time each case for >= 20 ms */
+
+static struct vmsort_bm bm;
+static uint16_t keys[65536],dup[65536],buf[65536];
+static volatile uint64_t sink;
+
+static inline uint64_t xorshift64(uint64_t *s){
+    uint64_t x=*s; x^=x<<13; x^=x>>7; x^=x<<17; return *s=x;
+}
+static uint64_t now_ns(void){
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC_RAW,&t);
+    return t.tv_sec*1000000000ULL+t.tv_nsec;
+}
+
+/* repeat prep (untimed) + op until REPS_MIN_NS of op time; ns per call */
+static double measure(void(*prep)(size_t),uint64_t(*op)(size_t),size_t n){
+    uint64_t total=0,reps=0,t0;
+    while(total<REPS_MIN_NS){
+        if(prep) prep(n);
+        t0=now_ns(); sink+=op(n); total+=now_ns()-t0; ++reps;
+    }
+    return (double)total/reps;
+}
+
+/* ---- set ---------------------------------------------------------- */
+static void prep_empty(size_t n){ (void)n; vmsort_bm_init(&bm); }
+static void prep_fill(size_t n){
+    vmsort_bm_init(&bm);
+    for(size_t i=0;i<n;++i) vmsort_bm_set(&bm,keys[i]);
+}
+static uint64_t op_set_random(size_t n){
+    uint64_t a=0; for(size_t i=0;i<n;++i) a+=vmsort_bm_set(&bm,keys[i]); return a;
+}
+static uint64_t op_set_seq(size_t n){
+    uint64_t a=0; for(size_t i=0;i<n;++i) a+=vmsort_bm_set(&bm,(u16)i); return a;
+}
+static uint64_t op_set_dup(size_t n){
+    uint64_t a=0; for(size_t i=0;i<n;++i) a+=vmsort_bm_set(&bm,dup[i]); return a;
+}
+
+/* ---- iterate ------------------------------------------------------ */
+static uint64_t op_decode_full(size_t n){
+    u32 pos=0; (void)n; return vmsort_bm_decode(&bm,&pos,65536,buf,65536);
+}
+static uint64_t op_next_full(size_t n){
+    uint64_t c=0; u16 k; (void)n;
+    vmsort_bm_reset_iter(&bm);
+    while(!vmsort_bm_next(&bm,&k)) ++c;
+    return c;
+}
+static uint64_t op_decode_4k(size_t n){      /* 16 random 4096‑key windows */
+    uint64_t c=0,s=n; (void)n;
+    for(int i=0;i<16;++i){
+        u32 lo=xorshift64(&s)&0xF000,pos=lo;
+        c+=vmsort_bm_decode(&bm,&pos,lo+4096,buf,4096);
+    }
+    return c;
+}
+static uint64_t op_bottom100(size_t n){
+    u32 pos=0; (void)n; return vmsort_bm_decode(&bm,&pos,65536,buf,100);
+}
+static uint64_t op_top100(size_t n){
+    u32 pos=65536; (void)n; return vmsort_bm_decode_rev(&bm,&pos,0,buf,100);
+}
+static uint64_t op_count(size_t n){
+    (void)n; return vmsort_bm_count(&bm,0,65536);
+}
+
+/* ---- init / reset ------------------------------------------------- */
+static uint64_t op_init(size_t n){ (void)n; vmsort_bm_init(&bm); return bm.iter_w; }
+static uint64_t op_clear(size_t n){ (void)n; vmsort_bm_clear(&bm); return bm.l1[0]; }
+
+int main(void){
+    static const double dens[]={0.001,0.01,0.1,0.5,1.0};
+    uint64_t seed=0xb17b17;
+    for(u32 i=0;i<65536;++i) keys[i]=i;
+    for(u32 i=65535;i;--i){ u32 j=xorshift64(&seed)%(i+1); u16 t=keys[i]; keys[i]=keys[j]; keys[j]=t; }
+    for(u32 i=0;i<65536;++i) dup[i]=keys[xorshift64(&seed)%256];
+
+    printf("%-8s %7s | %-28s | %-53s | %s\n","density","keys","set ns/key: rand   seq   dup",
+           "iterate ns/call: full  next  16x4k  bot100  top100 count","init  clear ns");
+    for(size_t d=0;d<sizeof(dens)/sizeof(dens[0]);++d){
+        size_t n=(size_t)(dens[d]*65536);
+        double sr=measure(prep_empty,op_set_random,n)/n,
+               ss=measure(prep_empty,op_set_seq,n)/n,
+               sd=measure(prep_empty,op_set_dup,n)/n;
+        prep_fill(n);
+        u32 pos=0; assert(vmsort_bm_decode(&bm,&pos,65536,buf,65536)==n);
+        double df=measure(NULL,op_decode_full,n),nf=measure(NULL,op_next_full,n),
+               d4=measure(NULL,op_decode_4k,n),b1=measure(NULL,op_bottom100,n),
+               t1=measure(NULL,op_top100,n),ct=measure(NULL,op_count,n),
+               in=measure(NULL,op_init,n),cl=measure(prep_fill,op_clear,n);
+        printf("%7.1f%% %7zu | %17.2f %5.2f %5.2f | %22.0f %6.0f %6.0f %6.0f %7.0f %5.0f | %4.0f %6.0f\n",
+               dens[d]*100,n,sr,ss,sd,df,nf,d4,b1,t1,ct,in,cl);
+    }
+    return 0;
+}
@@ -1,4 +1,4 @@
-/* gcc -O2 -std=gnu11 -Wall driver.c -o driver */
+/* gcc -O2 -std=gnu11 -Wall -pthread driver.c libvmsort.a -o driver */
 
 #include <stdio.h>
 #include <stdint.h>
@@ -10,15 +10,18 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/perf_event.h>
+#include "vmsort_lib.h"
 
 /* ------------ workload & ioctl constants ------------------------- */
 #define N_KEYS   50000UL
 #define TOTAL_WIN (256UL<<20)
 #define STRIDE   4096
 
-struct vmsort_iter { uint64_t ptr; uint32_t cap; uint32_t out; };
-#define VMSORT_IOCTL _IOWR('v', 1, struct vmsort_iter)
-
 /* ------------ RNG ------------------------------------------------ */
 static inline uint64_t xorshift64(uint64_t *s){
     uint64_t x=*s; x^=x>>12; x^=x<<25; x^=x>>27; *s=x;
@@ -73,19 +76,1099 @@ static void qsort16(uint16_t *a,size_t n){ qsort(a,n,2,cmp16); }
 static uint64_t diff_ns(struct timespec s,struct timespec e){
     return (e.tv_sec-s.tv_sec)*1000000000ULL+(e.tv_nsec-s.tv_nsec);
 }
+
+/* ------------ perf counters (-P) --------------------------------- */
+/* one fd per event, not a group, so a missing hardware counter (VMs)
+   only drops that column; cycles fall back to the task‑clock software
+   event.  Kernel time is counted when perf_event_paranoid allows it,
+   since that is where the faults are.                               */
+enum { PC_CYC, PC_INS, PC_DTLB_LD, PC_DTLB_ST, PC_LLC, PC_PF, PC_CS, PC_NR };
+static const char *pc_names[PC_NR]={"cyc","ins","dTLB-ld","dTLB-st","LLC","pf","cs"};
+static int pc_fd[PC_NR], pc_on, pc_taskclock;
+
+#define PC_CACHE(c,op) ((c)|((op)<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16))
+
+static int pc_open1(uint32_t type,uint64_t config){
+    struct perf_event_attr a={.type=type,.size=sizeof(a),.config=config,
+                              .disabled=1,.exclude_hv=1};
+    int fd=syscall(__NR_perf_event_open,&a,0,-1,-1,0);
+    if(fd<0){ a.exclude_kernel=1; fd=syscall(__NR_perf_event_open,&a,0,-1,-1,0); }
+    return fd;
+}
+
+static void pc_init(void){
+    static const struct { uint32_t type; uint64_t config; } ev[PC_NR]={
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE,PC_CACHE(PERF_COUNT_HW_CACHE_DTLB,PERF_COUNT_HW_CACHE_OP_READ)},
+        {PERF_TYPE_HW_CACHE,PC_CACHE(PERF_COUNT_HW_CACHE_DTLB,PERF_COUNT_HW_CACHE_OP_WRITE)},
+        {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_SOFTWARE,PERF_COUNT_SW_PAGE_FAULTS},
+        {PERF_TYPE_SOFTWARE,PERF_COUNT_SW_CONTEXT_SWITCHES},
+    };
+    for(int i=0;i<PC_NR;++i) pc_fd[i]=pc_open1(ev[i].type,ev[i].config);
+    if(pc_fd[PC_CYC]<0 && (pc_fd[PC_CYC]=pc_open1(PERF_TYPE_SOFTWARE,PERF_COUNT_SW_TASK_CLOCK))>=0){
+        pc_names[PC_CYC]="task-ns"; pc_taskclock=1;
+    }
+    pc_on=1;
+}
+
+static void pc_start(void){
+    if(!pc_on) return;
+    for(int i=0;i<PC_NR;++i) if(pc_fd[i]>=0){
+        ioctl(pc_fd[i],PERF_EVENT_IOC_RESET,0); ioctl(pc_fd[i],PERF_EVENT_IOC_ENABLE,0);
+    }
+}
+
+/* stop and read; ~0 marks an event that is not available */
+static void pc_stop(uint64_t v[PC_NR]){
+    if(!pc_on) return;
+    for(int i=0;i<PC_NR;++i) if(pc_fd[i]>=0) ioctl(pc_fd[i],PERF_EVENT_IOC_DISABLE,0);
+    for(int i=0;i<PC_NR;++i)
+        if(pc_fd[i]<0||read(pc_fd[i],&v[i],sizeof(v[i]))!=sizeof(v[i])) v[i]=~0ULL;
+}
+
+static void pc_print(const char *phase,const uint64_t v[PC_NR],size_t n){
+    if(!pc_on) return;
+    printf("  %-14s per key:",phase);
+    for(int i=0;i<PC_NR;++i)
+        if(v[i]==~0ULL) printf("  %s n/a",pc_names[i]);
+        else printf("  %s %.3f",pc_names[i],(double)v[i]/(n?n:1));
+    putchar('\n');
+}
+
 static void bench(const char* name,void(*fn)(uint16_t*,size_t),
                   uint16_t* arr,size_t n){
-    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    struct timespec t0,t1; uint64_t pv[PC_NR];
+    pc_start();
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
     fn(arr,n);
     clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    pc_stop(pv);
     uint64_t dt=diff_ns(t0,t1);
     printf("%-10s : %8.2f ms (%6.1f ns/key)\n",
            name, dt/1e6,(double)dt/n);
+    pc_print(name,pv,n);
     for(size_t i=1;i<n;++i) assert(arr[i-1]<=arr[i]);
 }
 
+/* ------------ session statistics (fdinfo) ----------------------- */
+static void dump_fdinfo(int fd){
+    char path[64], line[512];
+    snprintf(path,sizeof(path),"/proc/self/fdinfo/%d",fd);
+    FILE *f=fopen(path,"r"); if(!f){perror(path);return;}
+    while(fgets(line,sizeof(line),f)) fputs(line,stdout);
+    fclose(f);
+}
+
+static uint64_t fdinfo_u64(int fd,const char *key){
+    char path[64], line[512]; size_t kl=strlen(key); uint64_t v=0;
+    snprintf(path,sizeof(path),"/proc/self/fdinfo/%d",fd);
+    FILE *f=fopen(path,"r"); if(!f) return 0;
+    while(fgets(line,sizeof(line),f))
+        if(!strncmp(line,key,kl)&&line[kl]==':'){v=strtoull(line+kl+1,0,10);break;}
+    fclose(f);
+    return v;
+}
+
+/* ------------ multi‑threaded faulting (-t T) --------------------- */
+/* each thread writes cnt keys: keys[(first + k*step) % n]           */
+struct mt_arg { volatile char *base; const uint16_t *keys; size_t n,first,step,cnt;
+                pthread_barrier_t *bar; };
+
+static void *mt_worker(void *p){
+    struct mt_arg *a=p;
+    pthread_barrier_wait(a->bar);
+    for(size_t k=0,i=a->first;k<a->cnt;++k,i=(i+a->step)%a->n)
+        a->base[(size_t)a->keys[i]*STRIDE]=1;
+    return NULL;
+}
+
+/* one fresh session per run; overlap=0: disjoint key slices,
+   overlap=1: every thread inserts every key, from staggered offsets */
+static void mt_run(const uint16_t *keys,size_t n,int T,int overlap){
+    int fd=open("/dev/vmsort",O_RDWR);
+    if(fd<0){perror("open /dev/vmsort");exit(1);}
+    void* base=mmap(NULL,TOTAL_WIN,PROT_WRITE,MAP_SHARED,fd,0);
+    if(base==MAP_FAILED){perror("mmap");exit(1);}
+
+    pthread_t th[T]; struct mt_arg a[T]; pthread_barrier_t bar;
+    pthread_barrier_init(&bar,NULL,T+1);
+    for(int t=0;t<T;++t){
+        a[t]=(struct mt_arg){base,keys,n,0,0,0,&bar};
+        if(overlap){ a[t].first=t*n/T; a[t].step=1; a[t].cnt=n; }
+        else       { a[t].first=t;     a[t].step=T; a[t].cnt=(n-t+T-1)/T; }
+        pthread_create(&th[t],NULL,mt_worker,&a[t]);
+    }
+    struct timespec t0,t1;
+    pthread_barrier_wait(&bar); clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int t=0;t<T;++t) pthread_join(th[t],NULL);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    pthread_barrier_destroy(&bar);
+
+    uint16_t *out=malloc(n*2);
+    struct vmsort_iter it={.ptr=(uint64_t)out,.cap=n};
+    if(ioctl(fd,VMSORT_IOCTL,&it)){perror("ioctl");exit(1);}
+    assert(it.out==n);
+    for(size_t i=1;i<it.out;++i) assert(out[i-1]<out[i]);
+
+    uint64_t dt=diff_ns(t0,t1), faults=fdinfo_u64(fd,"faults");
+    if(!faults) faults=n;
+    printf("%-8s T=%-3d : %8.2f ms  %8lu faults  %7.3f Mfaults/s  (lost=%lu)\n",
+           overlap?"overlap":"disjoint",T,dt/1e6,(unsigned long)faults,
+           faults*1e3/dt,(unsigned long)fdinfo_u64(fd,"alloc_lost"));
+    free(out); munmap(base,TOTAL_WIN); close(fd);
+}
+
+/* ------------ parallel range extraction (-x P) ------------------- */
+/* split the key space into P equal ranges, VMSORT_IOC_COUNT each,
+   prefix‑sum the counts and let P threads VMSORT_IOC_RANGE their
+   slice straight into its final position in one output array        */
+#define PX_REPS 200
+
+struct px_arg { int fd; struct vmsort_range r; pthread_barrier_t *bar; };
+
+static void *px_worker(void *p){
+    struct px_arg *a=p;
+    for(int rep=0;rep<PX_REPS;++rep){
+        pthread_barrier_wait(a->bar);
+        if(ioctl(a->fd,VMSORT_IOC_RANGE,&a->r)){perror("ioctl range");exit(1);}
+        pthread_barrier_wait(a->bar);
+    }
+    return NULL;
+}
+
+static void px_run(int fd,size_t n,int P){
+    uint16_t *out=malloc(n*2);
+    pthread_t th[P]; struct px_arg a[P]; pthread_barrier_t bar;
+    uint32_t off=0;
+    pthread_barrier_init(&bar,NULL,P+1);
+
+    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int p=0;p<P;++p){
+        struct vmsort_range c={.lo=(uint32_t)(65536UL*p/P),.hi=(uint32_t)(65536UL*(p+1)/P)};
+        if(ioctl(fd,VMSORT_IOC_COUNT,&c)){perror("ioctl count");exit(1);}
+        a[p]=(struct px_arg){fd,c,&bar};
+        a[p].r.ptr=(uint64_t)(out+off); a[p].r.cap=c.out;
+        off+=c.out;
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    uint64_t count_ns=diff_ns(t0,t1);
+    assert(off==n);
+
+    for(int p=0;p<P;++p) pthread_create(&th[p],NULL,px_worker,&a[p]);
+    uint64_t dt=0;
+    for(int rep=0;rep<PX_REPS;++rep){
+        pthread_barrier_wait(&bar); clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        pthread_barrier_wait(&bar); clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        dt+=diff_ns(t0,t1);
+    }
+    for(int p=0;p<P;++p) pthread_join(th[p],NULL);
+    pthread_barrier_destroy(&bar);
+    for(size_t i=1;i<n;++i) assert(out[i-1]<out[i]);
+
+    dt/=PX_REPS;
+    printf("extract P=%-3d : %8.1f us (%5.2f ns/key, count pass %6.1f us)\n",
+           P,dt/1e3,(double)dt/n,count_ns/1e3);
+    free(out);
+}
+
+/* ------------ snapshot stress (-c W,R) ----------------------------- */
+/* W writers fault disjoint key slices in a fixed order while R readers
+   loop: reader 0 takes snapshots, the rest re‑read the latest one.
+   A snapshot is consistent iff it holds a prefix of every writer's
+   sequence (each writer's faults are ordered).                      */
+struct cs_shared { volatile char *base; const uint16_t *keys; size_t n;
+                   int W, fd; uint16_t *owner; uint32_t *seq;
+                   volatile int done; pthread_barrier_t bar; };
+struct cs_arg { struct cs_shared *sh; int id; uint64_t ops, ns, bad; };
+
+static void *cs_writer(void *p){
+    struct cs_arg *a=p; struct cs_shared *sh=a->sh;
+    pthread_barrier_wait(&sh->bar);
+    for(size_t i=a->id;i<sh->n;i+=sh->W){
+        sh->base[(size_t)sh->keys[i]*STRIDE]=1; a->ops++;
+    }
+    return NULL;
+}
+
+static void *cs_reader(void *p){
+    struct cs_arg *a=p; struct cs_shared *sh=a->sh;
+    uint16_t *out=malloc(sh->n*2);
+    uint32_t *cnt=calloc(sh->W,4), *top=calloc(sh->W,4);
+    unsigned long cmd=a->id?VMSORT_IOC_SNAP_READ:VMSORT_IOC_SNAPSHOT;
+    uint64_t last_gen=0, last_keys=0;
+    pthread_barrier_wait(&sh->bar);
+    do{
+        struct vmsort_snap sn={.ptr=(uint64_t)out,.cap=sh->n};
+        struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        if(ioctl(sh->fd,cmd,&sn)){perror("ioctl snapshot");exit(1);}
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        a->ns+=diff_ns(t0,t1); a->ops++;
+
+        int ok = sn.out==sn.keys && sn.gen>=last_gen &&
+                 (sn.gen!=last_gen || sn.keys==last_keys) && sn.keys>=last_keys;
+        memset(cnt,0,sh->W*4); memset(top,0,sh->W*4);
+        for(uint32_t i=0;i<sn.out;++i){
+            if(i&&out[i-1]>=out[i]) ok=0;
+            uint16_t w=sh->owner[out[i]];
+            cnt[w]++; if(sh->seq[out[i]]+1>top[w]) top[w]=sh->seq[out[i]]+1;
+        }
+        for(int w=0;w<sh->W;++w) if(cnt[w]!=top[w]) ok=0;
+        a->bad+=!ok; last_gen=sn.gen; last_keys=sn.keys;
+    }while(!sh->done);
+    free(out);free(cnt);free(top);
+    return NULL;
+}
+
+static void cs_run(const uint16_t *keys,size_t n,int W,int R){
+    struct cs_shared sh={.keys=keys,.n=n,.W=W};
+    sh.fd=open("/dev/vmsort",O_RDWR);
+    if(sh.fd<0){perror("open /dev/vmsort");exit(1);}
+    sh.base=mmap(NULL,TOTAL_WIN,PROT_WRITE,MAP_SHARED,sh.fd,0);
+    if(sh.base==MAP_FAILED){perror("mmap");exit(1);}
+    sh.owner=malloc(65536*2); sh.seq=malloc(65536*4);
+    for(size_t i=0;i<n;++i){ sh.owner[keys[i]]=i%W; sh.seq[keys[i]]=i/W; }
+
+    pthread_t th[W+R]; struct cs_arg a[W+R];
+    pthread_barrier_init(&sh.bar,NULL,W+R+1);
+    for(int t=0;t<W+R;++t){
+        a[t]=(struct cs_arg){&sh,t<W?t:t-W,0,0,0};
+        pthread_create(&th[t],NULL,t<W?cs_writer:cs_reader,&a[t]);
+    }
+    struct timespec t0,t1;
+    pthread_barrier_wait(&sh.bar); clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int t=0;t<W;++t) pthread_join(th[t],NULL);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    sh.done=1;
+    for(int t=W;t<W+R;++t) pthread_join(th[t],NULL);
+    pthread_barrier_destroy(&sh.bar);
+
+    uint64_t dt=diff_ns(t0,t1), snaps=0, reads=0, sns=0, rns=0, bad=0;
+    for(int t=W;t<W+R;++t){
+        if(t==W){snaps+=a[t].ops;sns+=a[t].ns;} else {reads+=a[t].ops;rns+=a[t].ns;}
+        bad+=a[t].bad;
+    }
+    printf("W=%d R=%d : insert %8.2f ms (%6.3f Mfaults/s)  "
+           "%lu snapshots (%6.1f us)  %lu reads (%6.1f us)  inconsistent=%lu\n",
+           W,R,dt/1e6,n*1e3/dt,(unsigned long)snaps,snaps?sns/1e3/snaps:0,
+           (unsigned long)reads,reads?rns/1e3/reads:0,(unsigned long)bad);
+    free(sh.owner);free(sh.seq);
+    munmap((void*)sh.base,TOTAL_WIN); close(sh.fd);
+}
+
+/* ------------ epoch streaming (-e) ------------------------------- */
+/* a producer thread writes a random key stream nonstop while the main
+   thread flips epochs every L produced keys and collects each sorted,
+   deduplicated window; every produced key must come back in some epoch */
+#define EP_TOTAL (4UL<<20)
+
+struct ep_shared { volatile char *base; volatile size_t produced; uint8_t *written; };
+
+static void *ep_producer(void *p){
+    struct ep_shared *sh=p; uint64_t seed=0x5eed;
+    for(size_t i=0;i<EP_TOTAL;++i){
+        uint16_t k=xorshift64(&seed)&0xFFFF;
+        sh->base[(size_t)k*STRIDE]=1; sh->written[k]=1;
+        __atomic_store_n(&sh->produced,i+1,__ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void ep_run(size_t L){
+    int fd=open("/dev/vmsort",O_RDWR);
+    if(fd<0){perror("open /dev/vmsort");exit(1);}
+    struct ep_shared sh={0};
+    sh.base=mmap(NULL,TOTAL_WIN,PROT_WRITE,MAP_SHARED,fd,0);
+    if(sh.base==MAP_FAILED){perror("mmap");exit(1);}
+    sh.written=calloc(65536,1);
+    uint8_t *seen=calloc(65536,1); uint16_t *out=malloc(65536*2);
+    uint64_t epochs=0, keys=0, flip_ns=0;
+
+    pthread_t th; struct timespec t0,t1,f0,f1;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    pthread_create(&th,NULL,ep_producer,&sh);
+    for(size_t next=L;;next+=L){
+        size_t p;
+        while((p=__atomic_load_n(&sh.produced,__ATOMIC_ACQUIRE))<next&&p<EP_TOTAL)
+            sched_yield();
+        if(p>=EP_TOTAL) pthread_join(th,NULL);
+
+        struct vmsort_snap sn={.ptr=(uint64_t)out,.cap=65536};
+        clock_gettime(CLOCK_MONOTONIC_RAW,&f0);
+        if(ioctl(fd,VMSORT_IOC_EPOCH_FLIP,&sn)){perror("ioctl flip");exit(1);}
+        clock_gettime(CLOCK_MONOTONIC_RAW,&f1);
+        flip_ns+=diff_ns(f0,f1); epochs++; keys+=sn.out;
+        assert(sn.out==sn.keys);
+        for(uint32_t i=0;i<sn.out;++i){ assert(!i||out[i-1]<out[i]); seen[out[i]]=1; }
+        if(p>=EP_TOTAL) break;
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    for(int k=0;k<65536;++k) assert(seen[k]==sh.written[k]);
+
+    uint64_t dt=diff_ns(t0,t1);
+    printf("epoch L=%-7zu: %6lu epochs  %8.2f Mkeys/s in  %7.1f unique/epoch  flip %7.1f us\n",
+           L,(unsigned long)epochs,EP_TOTAL*1e3/dt,(double)keys/epochs,flip_ns/1e3/epochs);
+    free(sh.written);free(seen);free(out);
+    munmap((void*)sh.base,TOTAL_WIN); close(fd);
+}
+
+/* ------------ set algebra (-a) ----------------------------------- */
+/* A = the benchmark key set, B = a second random set; time the kernel
+   word‑parallel ops against a sorted‑merge intersection in userspace  */
+#define SA_REPS 1000
+
+static int sa_open(void **base){
+    int fd=open("/dev/vmsort",O_RDWR);
+    if(fd<0){perror("open /dev/vmsort");exit(1);}
+    *base=mmap(NULL,TOTAL_WIN,PROT_WRITE,MAP_SHARED,fd,0);
+    if(*base==MAP_FAILED){perror("mmap");exit(1);}
+    return fd;
+}
+
+static size_t merge_and(const uint16_t *a,size_t na,const uint16_t *b,size_t nb,uint16_t *out){
+    size_t i=0,j=0,n=0;
+    while(i<na&&j<nb){
+        if(a[i]<b[j]) ++i; else if(b[j]<a[i]) ++j;
+        else { out[n++]=a[i]; ++i; ++j; }
+    }
+    return n;
+}
+
+static void sa_run(const uint16_t *keys,size_t n){
+    void *ba,*bb; int fa=sa_open(&ba), fb=sa_open(&bb);
+    uint64_t seed=0xb0b;
+    for(size_t i=0;i<n;++i) ((volatile char*)ba)[keys[i]*STRIDE]=1;
+    for(size_t i=0;i<n/2;++i) ((volatile char*)bb)[(xorshift64(&seed)&0xFFFF)*STRIDE]=1;
+
+    uint16_t *a=malloc(65536*2),*b=malloc(65536*2),*out=malloc(65536*2),*ref=malloc(65536*2);
+    struct vmsort_iter it={.ptr=(uint64_t)a,.cap=65536};
+    if(ioctl(fa,VMSORT_IOCTL,&it)){perror("ioctl");exit(1);}
+    size_t na=it.out; it.ptr=(uint64_t)b;
+    if(ioctl(fb,VMSORT_IOCTL,&it)){perror("ioctl");exit(1);}
+    size_t nb=it.out;
+
+    struct timespec t0,t1; size_t nref=0;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int r=0;r<SA_REPS;++r) nref=merge_and(a,na,b,nb,ref);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    printf("merge AND       : %8.2f us  (|A|=%zu |B|=%zu -> %zu)\n",
+           diff_ns(t0,t1)/1e3/SA_REPS,na,nb,nref);
+
+    static const struct { const char *name; uint32_t op; int extract; } ops[]={
+        {"vmsort AND card",VMSORT_SET_AND,0},{"vmsort AND",VMSORT_SET_AND,1},
+        {"vmsort OR",VMSORT_SET_OR,1},{"vmsort ANDNOT",VMSORT_SET_ANDNOT,1},
+        {"vmsort XOR",VMSORT_SET_XOR,1},
+    };
+    int32_t fds[2]={fa,fb};
+    for(size_t o=0;o<sizeof(ops)/sizeof(ops[0]);++o){
+        struct vmsort_setop so={.srcs=(uint64_t)fds,.nsrc=2,.op=ops[o].op,
+                                .ptr=ops[o].extract?(uint64_t)out:0,.cap=65536};
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        for(int r=0;r<SA_REPS;++r)
+            if(ioctl(fa,VMSORT_IOC_SETOP,&so)){perror("ioctl setop");exit(1);}
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        if(ops[o].op==VMSORT_SET_AND){
+            assert(so.card==nref);
+            if(ops[o].extract) assert(!memcmp(out,ref,nref*2));
+        }
+        printf("%-16s: %8.2f us  (card=%llu)\n",ops[o].name,
+               diff_ns(t0,t1)/1e3/SA_REPS,(unsigned long long)so.card);
+    }
+    free(a);free(b);free(out);free(ref);
+    munmap(ba,TOTAL_WIN); munmap(bb,TOTAL_WIN); close(fa); close(fb);
+}
+
+/* ------------ compressed extraction (-z) ------------------------- */
+/* per density: bytes/key, kernel encode time and userspace decode time
+   for every format and AUTO; each decode is checked against VMSORT_IOCTL */
+#define ZE_REPS 200
+
+static void ze_run(size_t n,int clustered){
+    static const char *names[]={"u16","varint","ef","runs","bitmap","auto"};
+    static const uint32_t fmts[]={VMSORT_FMT_U16,VMSORT_FMT_VARINT,VMSORT_FMT_EF,
+                                  VMSORT_FMT_RUNS,VMSORT_FMT_BITMAP,VMSORT_FMT_AUTO};
+    struct vms s; int r=vms_open(&s);
+    if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    uint64_t seed=0x5eed^n;
+    for(size_t i=0;i<n;){
+        uint16_t k=xorshift64(&seed)&0xFFFF;
+        if(clustered) for(int j=0;j<64&&i<n;++j) vms_insert(&s,k+j),++i;
+        else vms_insert(&s,k),++i;
+    }
+    uint16_t *ref=malloc(65536*2),*out=malloc((65536+8)*2);
+    uint8_t *buf=malloc(1<<18);
+    long nk=vms_extract(&s,ref,65536);
+    if(nk<0){fprintf(stderr,"extract: %s\n",strerror(-nk));exit(1);}
+
+    printf("%s n=%-6ld\n",clustered?"clustered":"random",nk);
+    for(size_t f=0;f<sizeof(fmts)/sizeof(fmts[0]);++f){
+        struct timespec t0,t1,t2; long len=0,got=0;
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        for(int i=0;i<ZE_REPS;++i)
+            if((len=vms_extract_enc(&s,buf,1<<18,fmts[f],NULL))<0){
+                fprintf(stderr,"encode %s: %s\n",names[f],strerror(-len));exit(1);
+            }
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        for(int i=0;i<ZE_REPS;++i) got=vms_decode(buf,len,out,65536+8);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t2);
+        assert(got==nk && !memcmp(out,ref,nk*2));
+        printf("  %-6s: %7.3f B/key  encode %8.2f us  decode %6.2f ns/key",
+               names[f],(double)len/(nk?nk:1),diff_ns(t0,t1)/1e3/ZE_REPS,
+               diff_ns(t1,t2)/(double)ZE_REPS/(nk?nk:1));
+        if(fmts[f]==VMSORT_FMT_AUTO) printf("  -> %s",names[((struct vmsort_enc_hdr*)buf)->fmt]);
+        putchar('\n');
+    }
+    free(ref);free(out);free(buf);
+    vms_close(&s);
+}
+
+/* ------------ pinned output (-p) --------------------------------- */
+/* repeated whole‑set extraction into one buffer: bounce + copy_to_user
+   (VMSORT_IOCTL) against decoding straight into the pinned buffer     */
+#define PN_REPS 2000
+
+static void pn_run(const uint16_t *keys,size_t n){
+    struct vms s; int r=vms_open(&s);
+    if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    for(size_t i=0;i<n;++i) vms_insert(&s,keys[i]);
+    uint16_t *ref=malloc(65536*2),*out=aligned_alloc(4096,65536*2);
+    long nk=vms_extract(&s,ref,65536);
+    if(nk<0){fprintf(stderr,"extract: %s\n",strerror(-nk));exit(1);}
+    if((r=vms_pin(&s,out,65536))){fprintf(stderr,"pin: %s\n",strerror(-r));exit(1);}
+
+    struct timespec t0,t1,t2; long got=0;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int i=0;i<PN_REPS;++i) got=vms_extract(&s,out,65536);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    for(int i=0;i<PN_REPS;++i) got=vms_extract_pinned(&s,0,65536,0,65536);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t2);
+    assert(got==nk && !memcmp(out,ref,nk*2));
+    printf("copy_to_user: %8.2f us/extract   pinned: %8.2f us/extract  (%ld keys, %llu pages)\n",
+           diff_ns(t0,t1)/1e3/PN_REPS,diff_ns(t1,t2)/1e3/PN_REPS,nk,
+           (unsigned long long)vms_stat(&s,"pinned_pages"));
+    vms_pin(&s,NULL,0);
+    free(ref);free(out);
+    vms_close(&s);
+}
+
+/* ------------ read() streaming (-r) ------------------------------ */
+/* whole sorted stream via pread() at read sizes 4 KiB .. 1 MiB against
+   one VMSORT_IOCTL into a caller‑sized buffer                        */
+#define RD_REPS 500
+
+static void rd_run(const uint16_t *keys,size_t n){
+    struct vms s; int r=vms_open(&s);
+    if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    for(size_t i=0;i<n;++i) vms_insert(&s,keys[i]);
+    uint16_t *ref=malloc(65536*2); uint8_t *out=malloc(1<<20);
+    long nk=vms_extract(&s,ref,65536);
+    if(nk<0){fprintf(stderr,"extract: %s\n",strerror(-nk));exit(1);}
+
+    struct timespec t0,t1;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int i=0;i<RD_REPS;++i) vms_extract(&s,(uint16_t*)out,65536);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    printf("ioctl        : %8.2f us/pass\n",diff_ns(t0,t1)/1e3/RD_REPS);
+
+    for(size_t sz=4096;sz<=(1<<20);sz<<=1){
+        size_t got=0;
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        for(int i=0;i<RD_REPS;++i){
+            ssize_t k; got=0;
+            while((k=pread(s.fd,out+got,sz,got))>0) got+=k;
+            if(k<0){perror("pread");exit(1);}
+        }
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        assert(got==(size_t)nk*2 && !memcmp(out,ref,got));
+        printf("read %7zu  : %8.2f us/pass  (%zu calls)\n",sz,
+               diff_ns(t0,t1)/1e3/RD_REPS,(got+sz-1)/sz+1);
+    }
+    free(ref);free(out);
+    vms_close(&s);
+}
+
+/* ------------ warm restart (-w) ---------------------------------- */
+/* rebuild a session by faulting every key vs restoring a saved image,
+   with and without the per‑key counters                              */
+static void wr_run(const uint16_t *keys,size_t n){
+    static const uint32_t flags[]={0,VMSORT_IMG_COUNTS};
+    uint16_t *ref=malloc(65536*2),*out=malloc(65536*2);
+    uint8_t *img=malloc(16+128+(1024+65536)*8);
+    struct timespec t0,t1;
+    for(size_t f=0;f<2;++f){
+        struct vms a,b; int r;
+        if((r=vms_open(&a))||(r=vms_open(&b))){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        for(size_t i=0;i<n;++i){
+            if(flags[f]) vms_count(&a,keys[i]); else vms_insert(&a,keys[i]);
+        }
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        uint64_t fault_ns=diff_ns(t0,t1);
+        long nk=vms_extract(&a,ref,65536);
+
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        long len=vms_save(&a,img,16+128+(1024+65536)*8,flags[f],NULL);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        if(len<0){fprintf(stderr,"save: %s\n",strerror(-len));exit(1);}
+        uint64_t save_ns=diff_ns(t0,t1);
+
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        long got=vms_restore(&b,img,len);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        if(got<0){fprintf(stderr,"restore: %s\n",strerror(-got));exit(1);}
+        assert(got==nk && vms_extract(&b,out,65536)==nk && !memcmp(out,ref,nk*2));
+        if(flags[f]) for(long i=0;i<nk;++i) assert(*vms_counter(&b,ref[i])==*vms_counter(&a,ref[i]));
+        printf("%-7s: fault %8.1f us   save %7.1f us (%ld B)   restore %7.1f us   (%ld keys)\n",
+               flags[f]?"counts":"keys",fault_ns/1e3,save_ns/1e3,len,diff_ns(t0,t1)/1e3,nk);
+        vms_close(&a); vms_close(&b);
+    }
+    free(ref);free(out);free(img);
+}
+
+/* ------------ memory pressure (-m MiB) --------------------------- */
+/* leave an unmapped session holding its chunks, apply pressure with an
+   anonymous balloon (run under memory.high: make memtest), then remap,
+   re‑sort and check the shrinker's reclaim / realloc counters        */
+static void mp_run(const uint16_t *keys,size_t n,size_t mib){
+    struct vms s; int r=vms_open(&s);
+    if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    for(size_t i=0;i<n;++i) vms_insert(&s,keys[i]);
+    printf("stale session : %3llu chunks, unmapping\n",(unsigned long long)vms_stat(&s,"chunks"));
+    munmap((void*)s.base,VMS_WIN);
+
+    struct timespec t0,t1;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    volatile char *bal=malloc(mib<<20);
+    if(!bal){perror("malloc");exit(1);}
+    for(size_t o=0;o<(mib<<20);o+=4096) bal[o]=1;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    printf("balloon       : %zu MiB in %.1f ms\n",mib,diff_ns(t0,t1)/1e6);
+    printf("after pressure: %3llu chunks, chunk_reclaim %llu\n",
+           (unsigned long long)vms_stat(&s,"chunks"),
+           (unsigned long long)vms_stat(&s,"chunk_reclaim"));
+
+    /* remap: chunks the shrinker took come back on first touch */
+    void *p=mmap(NULL,VMS_WIN,PROT_READ|PROT_WRITE,MAP_SHARED,s.fd,0);
+    if(p==MAP_FAILED){perror("mmap");exit(1);}
+    s.base=p;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(size_t i=0;i<n;++i) vms_insert(&s,keys[i]);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    uint16_t *out=malloc(65536*2);
+    long nk=vms_extract(&s,out,65536);
+    assert(nk==(long)n);
+    for(long i=1;i<nk;++i) assert(out[i-1]<out[i]);
+    printf("re-sort       : %.1f ms, %ld keys ok, chunk_realloc %llu\n",
+           diff_ns(t0,t1)/1e6,nk,(unsigned long long)vms_stat(&s,"chunk_realloc"));
+    free((void*)bal);free(out);
+    vms_close(&s);
+}
+
+/* ------------ memory budget (-b MiB) ----------------------------- */
+/* sort under a per‑session chunk budget: faults degrade to single pages
+   and then the sink page, but must all succeed with an exact key set  */
+static void bg_run(const uint16_t *keys,size_t n,size_t mib){
+    struct vms s; int r=vms_open(&s);
+    if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    if(vms_budget(&s,(uint64_t)mib<<20)<0){perror("budget");exit(1);}
+    struct timespec t0,t1;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(size_t i=0;i<n;++i) vms_insert(&s,keys[i]);
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    uint16_t *out=malloc(65536*2);
+    long nk=vms_extract(&s,out,65536);
+    assert(nk==(long)n);
+    for(long i=1;i<nk;++i) assert(out[i-1]<out[i]);
+    printf("budget %4zu MiB: %6.1f ms  held %6.1f MiB  huge %llu  small %llu"
+           "  degrade_small %llu  degrade_sink %llu\n",
+           mib,diff_ns(t0,t1)/1e6,vms_budget(&s,(uint64_t)mib<<20)/1048576.0,
+           (unsigned long long)vms_stat(&s,"alloc_huge"),
+           (unsigned long long)vms_stat(&s,"alloc_fallback"),
+           (unsigned long long)vms_stat(&s,"degrade_small"),
+           (unsigned long long)vms_stat(&s,"degrade_sink"));
+    free(out);
+    vms_close(&s);
+}
+
+/* ------------ fault latency vs page‑table prebuild (-l) ---------- */
+/* per‑fault cost of first touches in a fresh window, with and without
+   VMSORT_IOC_PREPARE, at several key densities                       */
+static void pl_run(void){
+    static const size_t dens[]={256,1024,8192,65536};
+    uint64_t seed=0x9a9e;
+    for(size_t d=0;d<sizeof(dens)/sizeof(dens[0]);++d)
+        for(int prep=0;prep<2;++prep){
+            struct vms s; int r=vms_open(&s);
+            if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+            struct timespec t0,t1,t2;
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+            if(prep&&(r=vms_prepare(&s))){fprintf(stderr,"prepare: %s\n",strerror(-r));exit(1);}
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+            /* stride across the window so sparse sets touch many tables */
+            for(size_t i=0;i<dens[d];++i)
+                vms_insert(&s,(uint16_t)(i*(65536/dens[d])+(xorshift64(&seed)%(65536/dens[d]))));
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t2);
+            printf("keys %6zu %-9s: %7.1f ns/fault  (prepare %7.1f us)\n",dens[d],
+                   prep?"prepared":"cold",diff_ns(t1,t2)/(double)dens[d],
+                   diff_ns(t0,t1)/1e3);
+            vms_close(&s);
+        }
+}
+
+/* ------------ io_uring passthrough (-u sessions) ----------------- */
+/* many small sessions: insert U_KEYS keys into each and extract them,
+   synchronously (faults + VMSORT_IOCTL) vs URING_CMD at queue depths
+   1..256.  A bare ring, no liburing.                                  */
+#define U_KEYS 64
+
+struct uring {
+    int fd; unsigned mask,*sq_tail,*sq_array,*cq_head,*cq_tail,cq_mask;
+    struct io_uring_sqe *sqes; struct io_uring_cqe *cqes;
+};
+
+static void ur_init(struct uring *u,unsigned entries){
+    struct io_uring_params p={0};
+    u->fd=syscall(__NR_io_uring_setup,entries,&p);
+    if(u->fd<0){perror("io_uring_setup");exit(1);}
+    size_t sql=p.sq_off.array+p.sq_entries*4, cql=p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+    char *sq=mmap(NULL,sql,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,u->fd,IORING_OFF_SQ_RING);
+    char *cq=mmap(NULL,cql,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,u->fd,IORING_OFF_CQ_RING);
+    u->sqes=mmap(NULL,p.sq_entries*sizeof(struct io_uring_sqe),PROT_READ|PROT_WRITE,
+                 MAP_SHARED|MAP_POPULATE,u->fd,IORING_OFF_SQES);
+    if(sq==MAP_FAILED||cq==MAP_FAILED||u->sqes==MAP_FAILED){perror("mmap ring");exit(1);}
+    u->mask=*(unsigned*)(sq+p.sq_off.ring_mask);
+    u->sq_tail=(unsigned*)(sq+p.sq_off.tail); u->sq_array=(unsigned*)(sq+p.sq_off.array);
+    u->cq_head=(unsigned*)(cq+p.cq_off.head); u->cq_tail=(unsigned*)(cq+p.cq_off.tail);
+    u->cq_mask=*(unsigned*)(cq+p.cq_off.ring_mask);
+    u->cqes=(struct io_uring_cqe*)(cq+p.cq_off.cqes);
+}
+
+static void ur_queue(struct uring *u,int fd,uint32_t op,uint64_t addr,uint32_t len,uint64_t tag){
+    unsigned t=*u->sq_tail, i=t&u->mask;
+    struct io_uring_sqe *e=&u->sqes[i];
+    memset(e,0,sizeof(*e));
+    e->opcode=IORING_OP_URING_CMD; e->fd=fd; e->cmd_op=op; e->user_data=tag;
+    struct vmsort_uring_cmd c={.addr=addr,.len=len};
+    memcpy(e->cmd,&c,sizeof(c));
+    u->sq_array[i]=i;
+    __atomic_store_n(u->sq_tail,t+1,__ATOMIC_RELEASE);
+}
+
+/* submit n queued, wait for at least `wait` completions, reap all */
+static unsigned ur_enter(struct uring *u,unsigned n,unsigned wait,int32_t *res){
+    if(syscall(__NR_io_uring_enter,u->fd,n,wait,IORING_ENTER_GETEVENTS,NULL,0)<0){
+        perror("io_uring_enter");exit(1);
+    }
+    unsigned h=*u->cq_head, t=__atomic_load_n(u->cq_tail,__ATOMIC_ACQUIRE), got=0;
+    for(;h!=t;++h,++got){
+        struct io_uring_cqe *c=&u->cqes[h&u->cq_mask];
+        if(c->res<0){fprintf(stderr,"uring_cmd: %s\n",strerror(-c->res));exit(1);}
+        if(res) res[c->user_data]=c->res;
+    }
+    __atomic_store_n(u->cq_head,h,__ATOMIC_RELEASE);
+    return got;
+}
+
+/* one op per session, at most qd in flight */
+static void ur_all(struct uring *u,const int *fds,int S,uint32_t op,uint64_t (*addr)(int),
+                   uint32_t len,unsigned qd,int32_t *res){
+    unsigned next=0, done=0, inflight=0;
+    while(done<(unsigned)S){
+        unsigned q=0;
+        while(inflight<qd&&next<(unsigned)S){ ur_queue(u,fds[next],op,addr(next),len,next); ++next; ++inflight; ++q; }
+        unsigned got=ur_enter(u,q,1,res);
+        inflight-=got; done+=got;
+    }
+}
+
+static uint16_t *u_keys,*u_out;
+static uint64_t u_key_addr(int i){ return (uint64_t)(u_keys+i*U_KEYS); }
+static uint64_t u_out_addr(int i){ return (uint64_t)(u_out+i*65536); }
+static uint64_t u_none(int i){ (void)i; return 0; }
+
+static void ur_run(int S){
+    int *fds=malloc(S*sizeof(int)); int32_t *res=malloc(S*4);
+    void **bases=malloc(S*sizeof(void*));
+    u_keys=malloc((size_t)S*U_KEYS*2); u_out=malloc((size_t)S*65536*2);
+    uint64_t seed=0x1a2b;
+    for(int i=0;i<S;++i){
+        fds[i]=sa_open(&bases[i]);
+        for(int k=0;k<U_KEYS;++k) u_keys[i*U_KEYS+k]=xorshift64(&seed)&0xFFFF;
+    }
+    struct timespec t0,t1,t2;
+
+    /* synchronous: fault the keys in, one VMSORT_IOCTL per session */
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(int i=0;i<S;++i)
+        for(int k=0;k<U_KEYS;++k) ((volatile char*)bases[i])[(size_t)u_keys[i*U_KEYS+k]*STRIDE]=1;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    for(int i=0;i<S;++i){
+        struct vmsort_iter it={.ptr=u_out_addr(i),.cap=65536};
+        if(ioctl(fds[i],VMSORT_IOCTL,&it)){perror("ioctl");exit(1);}
+        res[i]=it.out;
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t2);
+    printf("sync        : insert %7.2f us/session  extract %7.2f us/session\n",
+           diff_ns(t0,t1)/1e3/S,diff_ns(t1,t2)/1e3/S);
+    int32_t *ref=malloc(S*4); memcpy(ref,res,S*4);
+
+    struct uring u; ur_init(&u,256);
+    for(unsigned qd=1;qd<=256;qd<<=2){
+        ur_all(&u,fds,S,VMSORT_URING_RESET,u_none,0,qd,NULL);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        ur_all(&u,fds,S,VMSORT_URING_INSERT,u_key_addr,U_KEYS,qd,res);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        ur_all(&u,fds,S,VMSORT_URING_EXTRACT,u_out_addr,65536,qd,res);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t2);
+        for(int i=0;i<S;++i){
+            assert(res[i]==ref[i]);
+            for(int k=1;k<res[i];++k) assert(u_out[i*65536+k-1]<u_out[i*65536+k]);
+        }
+        printf("uring qd %3u: insert %7.2f us/session  extract %7.2f us/session\n",
+               qd,diff_ns(t0,t1)/1e3/S,diff_ns(t1,t2)/1e3/S);
+    }
+    for(int i=0;i<S;++i){ munmap(bases[i],TOTAL_WIN); close(fds[i]); }
+    close(u.fd);
+    free(fds);free(res);free(ref);free(bases);free(u_keys);free(u_out);
+}
+
+/* ------------ top‑N / bottom‑N (-n) ----------------------------- */
+/* bounded extraction against a full one, on the dense default set and
+   on 512 keys mid‑range, where both ends are empty l1 words          */
+#define TN_REPS 1000
+
+static void tn_run(const uint16_t *keys,size_t n){
+    static const uint32_t Ns[]={1,10,100,1000};
+    uint16_t *full=malloc(65536*2),*out=malloc(65536*2);
+    struct timespec t0,t1;
+    for(int sparse=0;sparse<2;++sparse){
+        struct vms s; int r=vms_open(&s);
+        if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+        size_t m=sparse?2000:n;
+        for(size_t i=0;i<m;++i) vms_insert(&s,sparse?32768+keys[i]%512:keys[i]);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        long nk=0;
+        for(int i=0;i<TN_REPS;++i) nk=vms_extract(&s,full,65536);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        printf("%-6s %5ld keys: full %8.2f us\n",sparse?"sparse":"dense",nk,diff_ns(t0,t1)/1e3/TN_REPS);
+        for(size_t z=0;z<sizeof(Ns)/sizeof(Ns[0]);++z){
+            uint32_t N=Ns[z]; uint64_t ns[2];
+            for(int desc=0;desc<2;++desc){
+                long got=0;
+                clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+                for(int i=0;i<TN_REPS;++i) got=desc?vms_top(&s,out,N):vms_bottom(&s,out,N);
+                clock_gettime(CLOCK_MONOTONIC_RAW,&t1); ns[desc]=diff_ns(t0,t1);
+                assert(got==(N<nk?(long)N:nk));
+                for(long i=0;i<got;++i) assert(out[i]==(desc?full[nk-1-i]:full[i]));
+            }
+            printf("   N=%4u: bottom %8.2f us   top %8.2f us\n",N,ns[0]/1e3/TN_REPS,ns[1]/1e3/TN_REPS);
+        }
+        vms_close(&s);
+    }
+    free(full);free(out);
+}
+
+/* ------------ priority queue: Dijkstra (-q) --------------------- */
+/* random digraph, DJ_DEG edges per node, weights 1..DJ_WMAX, lazy
+   deletion in every queue.  Baselines: a binary heap (what
+   std::priority_queue is) and a monotone radix heap.                 */
+#define DJ_NODES (1U<<17)
+#define DJ_DEG   8
+#define DJ_WMAX  256
+
+static uint32_t *dj_adj; static uint16_t *dj_w;
+
+struct bheap { uint64_t *a; size_t n; };
+static void bh_push(struct bheap *h,uint64_t v){
+    size_t i=h->n++;
+    while(i&&h->a[(i-1)/2]>v){ h->a[i]=h->a[(i-1)/2]; i=(i-1)/2; }
+    h->a[i]=v;
+}
+static uint64_t bh_pop(struct bheap *h){
+    uint64_t r=h->a[0],v=h->a[--h->n]; size_t i=0,c;
+    while((c=2*i+1)<h->n){
+        if(c+1<h->n&&h->a[c+1]<h->a[c]) ++c;
+        if(h->a[c]>=v) break;
+        h->a[i]=h->a[c]; i=c;
+    }
+    h->a[i]=v; return r;
+}
+
+/* bucket i >= 1 holds keys whose highest bit differing from last is i-1 */
+struct rheap { uint64_t *b[18]; size_t n[18],cap[18],size; uint32_t last; };
+static int rh_idx(const struct rheap *h,uint32_t k){ return k==h->last?0:32-__builtin_clz(k^h->last); }
+static void rh_add(struct rheap *h,int i,uint64_t v){
+    if(h->n[i]==h->cap[i]){ h->cap[i]=h->cap[i]?2*h->cap[i]:64; h->b[i]=realloc(h->b[i],h->cap[i]*8); }
+    h->b[i][h->n[i]++]=v;
+}
+static void rh_push(struct rheap *h,uint64_t v){ rh_add(h,rh_idx(h,v>>32),v); ++h->size; }
+static uint64_t rh_pop(struct rheap *h){
+    if(!h->n[0]){
+        int i=1; while(!h->n[i]) ++i;
+        uint32_t m=UINT32_MAX;
+        for(size_t j=0;j<h->n[i];++j) if((h->b[i][j]>>32)<m) m=h->b[i][j]>>32;
+        h->last=m;
+        size_t n=h->n[i]; h->n[i]=0;
+        for(size_t j=0;j<n;++j) rh_add(h,rh_idx(h,h->b[i][j]>>32),h->b[i][j]);
+    }
+    --h->size;
+    return h->b[0][--h->n[0]];
+}
+
+enum { DJ_BHEAP, DJ_RHEAP, DJ_VMSORT };
+
+static uint64_t dj_run(int kind,uint32_t *dist,size_t *ops){
+    struct bheap bh={malloc((DJ_NODES*DJ_DEG+1)*8),0}; struct rheap rh={0}; struct vms_pq q;
+    struct timespec t0,t1; int r;
+    if(kind==DJ_VMSORT&&(r=vms_pq_open(&q))){fprintf(stderr,"vms_pq_open: %s\n",strerror(-r));exit(1);}
+    for(uint32_t v=0;v<DJ_NODES;++v) dist[v]=UINT32_MAX;
+    *ops=0;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    dist[0]=0;
+    switch(kind){
+    case DJ_BHEAP:  bh_push(&bh,0); break;
+    case DJ_RHEAP:  rh_push(&rh,0); break;
+    case DJ_VMSORT: vms_pq_push(&q,0,0); break;
+    }
+    for(;;){
+        uint32_t d,u;
+        if(kind==DJ_BHEAP){ if(!bh.n) break; uint64_t e=bh_pop(&bh); d=e>>32; u=(uint32_t)e; }
+        else if(kind==DJ_RHEAP){ if(!rh.size) break; uint64_t e=rh_pop(&rh); d=e>>32; u=(uint32_t)e; }
+        else { uint16_t p; if(vms_pq_pop(&q,&p,&u)) break; d=p; }
+        ++*ops;
+        if(d>dist[u]) continue;                         /* stale entry */
+        for(uint32_t e=u*DJ_DEG;e<(u+1)*DJ_DEG;++e){
+            uint32_t v=dj_adj[e],nd=d+dj_w[e];
+            if(nd>=dist[v]) continue;
+            assert(nd<65536);
+            dist[v]=nd; ++*ops;
+            switch(kind){
+            case DJ_BHEAP:  bh_push(&bh,(uint64_t)nd<<32|v); break;
+            case DJ_RHEAP:  rh_push(&rh,(uint64_t)nd<<32|v); break;
+            case DJ_VMSORT:
+                if((r=vms_pq_push(&q,nd,v))){fprintf(stderr,"vms_pq_push: %s\n",strerror(-r));exit(1);}
+                break;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+    if(kind==DJ_VMSORT) vms_pq_close(&q);
+    for(int i=0;i<18;++i) free(rh.b[i]);
+    free(bh.a);
+    return diff_ns(t0,t1);
+}
+
+static void dj_bench(void){
+    static const char *names[]={"binary heap","radix heap","vmsort pq"};
+    uint32_t *dist[3]; uint64_t seed=0xd1d1;
+    dj_adj=malloc(DJ_NODES*DJ_DEG*4); dj_w=malloc(DJ_NODES*DJ_DEG*2);
+    for(size_t e=0;e<DJ_NODES*DJ_DEG;++e){
+        dj_adj[e]=xorshift64(&seed)%DJ_NODES;
+        dj_w[e]=1+xorshift64(&seed)%DJ_WMAX;
+    }
+    for(int k=0;k<3;++k){
+        size_t ops; dist[k]=malloc(DJ_NODES*4);
+        uint64_t dt=dj_run(k,dist[k],&ops);
+        if(k) assert(!memcmp(dist[k],dist[0],DJ_NODES*4));
+        printf("%-12s: %8.2f ms  (%5.1f ns/op, %zu push+pop)\n",names[k],dt/1e6,(double)dt/ops,ops);
+    }
+    for(int k=0;k<3;++k) free(dist[k]);
+    free(dj_adj);free(dj_w);
+}
+
+/* ------------ delta extraction (-d) ----------------------------- */
+/* a session that already knows most keys; each poll inserts a few new
+   ones and reads them back with DELTA, against a full extraction.    */
+#define DL_POLLS 4
+
+static void dl_run(const uint16_t *keys,size_t n){
+    static const size_t sizes[]={1,16,256,1024};
+    struct vms s; int r=vms_open(&s);
+    if(r){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    size_t known=n-DL_POLLS*(1+16+256+1024),at=known;
+    uint16_t *out=malloc(65536*2),*ref=malloc(65536*2);
+    for(size_t i=0;i<known;++i) vms_insert(&s,keys[i]);
+    long d=vms_extract_delta(&s,out,65536);
+    assert(d==(long)known && !vms_extract_delta(&s,out,65536));
+
+    struct timespec t0,t1;
+    for(size_t z=0;z<sizeof(sizes)/sizeof(sizes[0]);++z){
+        uint64_t d_ns=0,f_ns=0; long full=0;
+        for(int p=0;p<DL_POLLS;++p,at+=sizes[z]){
+            for(size_t i=0;i<sizes[z];++i) vms_insert(&s,keys[at+i]);
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+            d=vms_extract_delta(&s,out,65536);
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t1); d_ns+=diff_ns(t0,t1);
+            memcpy(ref,keys+at,sizes[z]*2); qsort16(ref,sizes[z]);
+            assert(d==(long)sizes[z] && !memcmp(out,ref,d*2));
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+            full=vms_extract(&s,out,65536);
+            clock_gettime(CLOCK_MONOTONIC_RAW,&t1); f_ns+=diff_ns(t0,t1);
+        }
+        printf("poll %5zu new: delta %8.2f us   full %8.2f us (%ld keys)\n",
+               sizes[z],d_ns/1e3/DL_POLLS,f_ns/1e3/DL_POLLS,full);
+    }
+    free(out);free(ref);
+    vms_close(&s);
+}
+
+/* ------------ segmented sort (-g) -------------------------------- */
+/* S segments of K random local keys each, 1 << shift >= 2K wide; the
+   session holds 65536 >> shift segments per round, each round one
+   SEGMENTS call with RESET.  Baselines: qsort + unique per segment, and
+   a fresh session (open, mmap, fault, extract, close) per segment.   */
+#define SG_MAX_KEYS (16UL<<20)
+
+static void sg_run(size_t S,size_t K){
+    if(S*K>SG_MAX_KEYS){ printf("segs %6zu x %4zu keys: skipped (> %lu keys)\n",S,K,SG_MAX_KEYS); return; }
+    unsigned shift=1; while((1UL<<shift)<2*K) ++shift;
+    size_t per=65536>>shift,rounds=(S+per-1)/per;
+    uint16_t *keys=malloc(S*K*2),*ref=malloc(S*K*2),*out=malloc(65536*2);
+    uint32_t *roff=malloc((S+1)*4),*offs=malloc((per+1)*4);
+    uint64_t seed=0x5e9^S^K<<20;
+    for(size_t i=0;i<S*K;++i) keys[i]=xorshift64(&seed)&((1U<<shift)-1);
+
+    struct timespec t0,t1; uint64_t q_ns,v_ns=0,n_ns;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    roff[0]=0;
+    for(size_t g=0;g<S;++g){
+        uint16_t *a=ref+roff[g]; memcpy(a,keys+g*K,K*2); qsort16(a,K);
+        size_t u=0; for(size_t i=0;i<K;++i) if(!u||a[u-1]!=a[i]) a[u++]=a[i];
+        roff[g+1]=roff[g]+u;
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1); q_ns=diff_ns(t0,t1);
+
+    struct vms v; int r;
+    if((r=vms_open(&v))){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+    for(size_t g0=0;g0<S;g0+=per){
+        size_t R=S-g0<per?S-g0:per;
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        for(size_t j=0;j<R;++j)
+            for(size_t i=0;i<K;++i) vms_seg_insert(&v,shift,j,keys[(g0+j)*K+i]);
+        long n=vms_segments(&v,shift,out,65536,offs,VMSORT_SEG_RESET);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1); v_ns+=diff_ns(t0,t1);
+        if(n<0){fprintf(stderr,"segments: %s\n",strerror(-n));exit(1);}
+        for(size_t j=0;j<R;++j){
+            uint32_t len=roff[g0+j+1]-roff[g0+j];
+            assert(offs[j+1]-offs[j]==len && !memcmp(out+offs[j],ref+roff[g0+j],len*2));
+        }
+        assert(offs[R]==(uint32_t)n && offs[per]==(uint32_t)n);
+    }
+    vms_close(&v);
+
+    size_t N=S<256?S:256;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+    for(size_t g=0;g<N;++g){
+        if((r=vms_open(&v))){fprintf(stderr,"vms_open: %s\n",strerror(-r));exit(1);}
+        for(size_t i=0;i<K;++i) vms_insert(&v,keys[g*K+i]);
+        assert(vms_extract(&v,out,65536)==(long)(roff[g+1]-roff[g]));
+        vms_close(&v);
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW,&t1); n_ns=diff_ns(t0,t1);
+
+    printf("segs %6zu x %4zu keys: vmsort %6.1f ns/key %7.2f us/seg (%zu rounds of %zu)"
+           "   qsort %6.1f ns/key   session/seg %8.2f us\n",
+           S,K,(double)v_ns/(S*K),v_ns/1e3/S,rounds,per,(double)q_ns/(S*K),n_ns/1e3/N);
+    free(keys);free(ref);free(out);free(roff);free(offs);
+}
+
+/* ------------ sharded sort scaling (-S) ------------------------- */
+/* vms_sort_sharded over P = 1, 2, 4, ... and every CPU.  Strong: one
+   SH_KEYS input for all P.  Weak: SH_KEYS/8 input keys per shard; the
+   key space stays 65536, so faults per shard still shrink as 1/P.
+   Best of SH_REPS, unique and duplicate‑keeping output.              */
+#define SH_KEYS (1UL<<24)
+#define SH_REPS 3
+
+static uint64_t sh_time(const uint16_t *in,size_t n,uint16_t *out,int P,unsigned flags,
+                        const uint32_t *hist,long uniq){
+    uint64_t best=~0ULL; struct timespec t0,t1;
+    for(int r=0;r<SH_REPS;++r){
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t0);
+        long got=vms_sort_sharded(in,n,out,P,flags);
+        clock_gettime(CLOCK_MONOTONIC_RAW,&t1);
+        if(got<0){fprintf(stderr,"vms_sort_sharded: %s\n",strerror(-got));exit(1);}
+        assert(got==(flags&VMS_SHARD_DUPS?(long)n:uniq));
+        if(diff_ns(t0,t1)<best) best=diff_ns(t0,t1);
+    }
+    if(hist) for(size_t i=0,k=0;i<(size_t)(flags&VMS_SHARD_DUPS?(long)n:uniq);++k){
+        if(!hist[k]) continue;
+        for(uint32_t c=flags&VMS_SHARD_DUPS?hist[k]:1;c;--c) assert(out[i++]==k);
+    }
+    return best;
+}
+
+static void sh_run(void){
+    int ncpu=(int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max=SH_KEYS>(size_t)ncpu*(SH_KEYS/8)?SH_KEYS:(size_t)ncpu*(SH_KEYS/8);
+    uint16_t *in=malloc(max*2),*out=malloc(max*2);
+    static uint32_t hist[65536];
+    uint64_t seed=0x5ba4d; long uniq=0;
+    if(!in||!out){perror("malloc");exit(1);}
+    for(size_t i=0;i<max;++i) in[i]=xorshift64(&seed)&0xFFFF;
+    for(size_t i=0;i<SH_KEYS;++i) uniq+=!hist[in[i]]++;
+
+    printf("strong: %lu keys (%ld unique), %d cpus\n",SH_KEYS,uniq,ncpu);
+    uint64_t u1=0,d1=0;
+    for(int P=1;;P=P*2>ncpu&&P<ncpu?ncpu:P*2){
+        uint64_t u=sh_time(in,SH_KEYS,out,P,0,P==1?hist:NULL,uniq),
+                 d=sh_time(in,SH_KEYS,out,P,VMS_SHARD_DUPS,P==1?hist:NULL,uniq);
+        if(P==1){u1=u;d1=d;}
+        printf("  P=%-3d unique %8.2f ms  x%5.2f  eff %5.1f%%   dups %8.2f ms  x%5.2f  eff %5.1f%%\n",
+               P,u/1e6,(double)u1/u,100.0*u1/u/P,d/1e6,(double)d1/d,100.0*d1/d/P);
+        if(P>=ncpu) break;
+    }
+    printf("weak: %lu keys per shard\n",SH_KEYS/8);
+    for(int P=1;;P=P*2>ncpu&&P<ncpu?ncpu:P*2){
+        size_t n=(size_t)P*(SH_KEYS/8); long un=0;
+        memset(hist,0,sizeof(hist));
+        for(size_t i=0;i<n;++i) un+=!hist[in[i]]++;
+        uint64_t u=sh_time(in,n,out,P,0,NULL,un),
+                 d=sh_time(in,n,out,P,VMS_SHARD_DUPS,NULL,un);
+        if(P==1){u1=u;d1=d;}
+        printf("  P=%-3d %9zu keys  unique %8.2f ms  eff %5.1f%%   dups %8.2f ms  eff %5.1f%%\n",
+               P,n,u/1e6,100.0*u1/u,d/1e6,100.0*d1/d);
+        if(P>=ncpu) break;
+    }
+    free(in);free(out);
+}
+
 /* ------------ main ----------------------------------------------- */
-int main(void){
+int main(int argc,char **argv){
+    int show_stats=0, threads=0, xthreads=0, cw=0, cr=0, epochs=0, setops=0, enc=0, pinned=0, reads=0, warm=0, ptlat=0, usess=0, segs=0, delta=0, pq=0, topn=0, shard=0, opt;
+    size_t balloon=0, budget=0;
+    while((opt=getopt(argc,argv,"st:x:c:eazprwm:b:lu:PgdqnS"))!=-1){
+        switch(opt){
+        case 's': show_stats=1; break;
+        case 't': threads=atoi(optarg); break;
+        case 'x': xthreads=atoi(optarg); break;
+        case 'c': if(sscanf(optarg,"%d,%d",&cw,&cr)!=2||cw<1||cr<1) cw=0; break;
+        case 'e': epochs=1; break;
+        case 'a': setops=1; break;
+        case 'z': enc=1; break;
+        case 'p': pinned=1; break;
+        case 'r': reads=1; break;
+        case 'w': warm=1; break;
+        case 'l': ptlat=1; break;
+        case 'u': usess=atoi(optarg); break;
+        case 'P': pc_init(); break;
+        case 'g': segs=1; break;
+        case 'd': delta=1; break;
+        case 'q': pq=1; break;
+        case 'n': topn=1; break;
+        case 'S': shard=1; break;
+        case 'm': balloon=strtoul(optarg,NULL,0); break;
+        case 'b': budget=strtoul(optarg,NULL,0); break;
+        default:
+            fprintf(stderr,"usage: %s [-s] [-t max_threads] [-x max_threads]"
+                           " [-c writers,readers] [-e] [-a] [-z] [-p] [-r] [-w]"
+                           " [-m balloon_MiB] [-b budget_MiB] [-l] [-u sessions]"
+                           " [-P] [-g] [-d] [-q] [-n] [-S]\n",argv[0]);
+            return 1;
+        }
+    }
+
     /* create unique 16‑bit key set */
     uint16_t *orig=malloc(N_KEYS*2),*qa=malloc(N_KEYS*2),
              *ra=malloc(N_KEYS*2),*ma=malloc(N_KEYS*2);
@@ -98,24 +1181,122 @@ int main(void){
     }
     memcpy(qa,orig,N_KEYS*2); memcpy(ra,orig,N_KEYS*2); memcpy(ma,orig,N_KEYS*2);
 
+    if(shard){
+        sh_run();
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(topn){
+        tn_run(orig,N_KEYS);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(pq){
+        dj_bench();
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(delta){
+        dl_run(orig,N_KEYS);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(segs){
+        static const size_t S[]={1000,10000,100000},K[]={10,100,1000};
+        for(size_t i=0;i<3;++i) for(size_t j=0;j<3;++j) sg_run(S[i],K[j]);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(usess>0){
+        ur_run(usess);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(ptlat){
+        pl_run();
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(budget){
+        for(size_t mib=budget;mib;mib/=4) bg_run(orig,N_KEYS,mib);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(balloon){
+        mp_run(orig,N_KEYS,balloon);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(warm){
+        wr_run(orig,N_KEYS);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(reads){
+        rd_run(orig,N_KEYS);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(pinned){
+        pn_run(orig,N_KEYS);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(enc){
+        static const size_t dens[]={1000,8000,32000,60000};
+        for(size_t i=0;i<sizeof(dens)/sizeof(dens[0]);++i) ze_run(dens[i],0);
+        ze_run(8000,1);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(setops){
+        sa_run(orig,N_KEYS);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(epochs){
+        for(size_t L=1024;L<=(256UL<<10);L<<=2) ep_run(L);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(cw>0){
+        cs_run(orig,N_KEYS,cw,cr);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+    if(threads>0){
+        for(int T=1;T<=threads;T<<=1) mt_run(orig,N_KEYS,T,0);
+        for(int T=1;T<=threads;T<<=1) mt_run(orig,N_KEYS,T,1);
+        free(orig);free(qa);free(ra);free(ma);
+        return 0;
+    }
+
     /* ---- /dev/vmsort ------------------------------------------------*/
     int fd=open("/dev/vmsort",O_RDWR);
     if(fd<0){perror("open /dev/vmsort");return 1;}
     void* base=mmap(NULL,TOTAL_WIN,PROT_WRITE,MAP_SHARED,fd,0);
     if(base==MAP_FAILED){perror("mmap");return 1;}
 
-    struct timespec s0,s1; clock_gettime(CLOCK_MONOTONIC_RAW,&s0);
+    uint16_t *out=malloc(N_KEYS*2);
+    struct vmsort_iter it={.ptr=(uint64_t)out,.cap=N_KEYS};
+    struct timespec s0,s1; uint64_t pv_fault[PC_NR],pv_ext[PC_NR];
+    pc_start();
+    clock_gettime(CLOCK_MONOTONIC_RAW,&s0);
     for(size_t i=0;i<N_KEYS;++i)
         ((volatile char*)base)[orig[i]*STRIDE]=1;
+    pc_stop(pv_fault); pc_start();
 
-    uint16_t *out=malloc(N_KEYS*2);
-    struct vmsort_iter it={.ptr=(uint64_t)out,.cap=N_KEYS};
     ioctl(fd,VMSORT_IOCTL,&it);
     clock_gettime(CLOCK_MONOTONIC_RAW,&s1);
+    pc_stop(pv_ext);
     uint64_t dt=diff_ns(s0,s1);
     printf("vmsort     : %8.2f ms (%6.1f ns/key, out=%u)\n",
            dt/1e6,(double)dt/N_KEYS,it.out);
+    pc_print("fault loop",pv_fault,N_KEYS);
+    pc_print("extraction",pv_ext,N_KEYS);
     for(size_t i=1;i<it.out;++i) assert(out[i-1]<=out[i]);
+    for(int P=1;P<=xthreads;P<<=1) px_run(fd,it.out,P);
+    if(show_stats) dump_fdinfo(fd);
     munmap(base,TOTAL_WIN); close(fd);
 
     /* ---- user‑space sorts ----------------------------------------- */
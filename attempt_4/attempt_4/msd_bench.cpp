@@ -0,0 +1,98 @@
+// msd_bench.cpp  —  vms_sort32/vms_sort64 vs LSD radix and std::sort
+//
+// Wide keys with duplicates kept, uniform over the whole key width and
+// clustered into a narrow range (dense low 16 bits per MSD bucket, the
+// case the bitmap leaves are for).  The session backend runs only when
+// /dev/vmsort opens.
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "vmsort_lib.h"
+
+static std::uint64_t xorshift64(std::uint64_t &s)
+{
+    s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+    return s;
+}
+
+template <class F>
+static double time_ns(F &&f, int reps)
+{
+    double best = 1e300;
+    for (int i = 0; i < reps; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::nano>(
+                                  std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+// LSD radix on 8-bit digits over the full width
+template <class K>
+static void radix_lsd(std::vector<K> &a, std::vector<K> &tmp)
+{
+    for (unsigned sh = 0; sh < 8 * sizeof(K); sh += 8) {
+        std::size_t cnt[257] = {};
+        for (K k : a) ++cnt[(k >> sh & 0xFF) + 1];
+        for (int i = 0; i < 256; ++i) cnt[i + 1] += cnt[i];
+        for (K k : a) tmp[cnt[k >> sh & 0xFF]++] = k;
+        a.swap(tmp);
+    }
+}
+
+static int vms_sort(std::uint32_t *a, std::size_t n, int t, unsigned f) { return vms_sort32(a, n, t, f); }
+static int vms_sort(std::uint64_t *a, std::size_t n, int t, unsigned f) { return vms_sort64(a, n, t, f); }
+
+template <class K>
+static void run(const char *name, std::size_t n, K range, bool session, int reps)
+{
+    std::vector<K> keys(n), a, tmp(n), ref;
+    std::uint64_t seed = 0x5eed ^ n ^ sizeof(K);
+    K base = range ? K(xorshift64(seed)) & ~K(range - 1) : 0;
+    for (auto &k : keys) k = range ? base + (K(xorshift64(seed)) & K(range - 1)) : K(xorshift64(seed));
+    ref = keys;
+    std::sort(ref.begin(), ref.end());
+
+    int nt = int(std::thread::hardware_concurrency());
+    auto vms = [&](int t, unsigned f) {
+        return time_ns([&] {
+            a = keys;
+            int r = vms_sort(a.data(), n, t, f);
+            assert(!r);
+            (void)r;
+        }, reps);
+    };
+    double t1 = vms(1, 0), tn = vms(nt, 0);
+    assert(a == ref);
+    double ts = 0;
+    if (session) {
+        ts = vms(nt, VMS_MSD_SESSION);
+        assert(a == ref);
+    }
+    double tr = time_ns([&] { a = keys; radix_lsd(a, tmp); }, reps);
+    assert(a == ref);
+    double tstd = time_ns([&] { a = keys; std::sort(a.begin(), a.end()); }, reps);
+
+    std::printf("%-14s %9zu keys: vms 1t %6.2f  vms %2dt %6.2f  session %2dt ", name, n,
+                t1 / n, nt, tn / n, nt);
+    if (session) std::printf("%6.2f", ts / n); else std::printf("%6s", "-");
+    std::printf("  lsd radix %6.2f  std::sort %6.2f ns/key\n", tr / n, tstd / n);
+}
+
+int main()
+{
+    struct vms s;
+    bool session = !vms_open(&s);
+    if (session) vms_close(&s);
+    else std::printf("/dev/vmsort unavailable: session backend skipped\n");
+
+    run<std::uint32_t>("u32 uniform", 1 << 24, 0, session, 3);
+    run<std::uint32_t>("u32 in 2^24", 1 << 24, 1u << 24, session, 3);
+    run<std::uint64_t>("u64 uniform", 1 << 23, 0, session, 3);
+    run<std::uint64_t>("u64 in 2^28", 1 << 23, 1ull << 28, session, 3);
+    return 0;
+}
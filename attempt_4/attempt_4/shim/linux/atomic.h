@@ -0,0 +1,21 @@
+/* shim/linux/atomic.h  —  the atomic_long ops vmsort_bm.h uses */
+#ifndef VMSORT_SHIM_ATOMIC_H_
+#define VMSORT_SHIM_ATOMIC_H_
+
+#include <linux/types.h>
+
+typedef struct { long counter; } atomic_long_t;
+
+/* relaxed RMW, like the kernel's non‑returning atomics */
+static inline void atomic_long_or(unsigned long v, atomic_long_t *p)
+{
+        __atomic_fetch_or((unsigned long *)&p->counter, v, __ATOMIC_RELAXED);
+}
+
+static inline unsigned long atomic_long_xchg(atomic_long_t *p, unsigned long v)
+{
+        return __atomic_exchange_n((unsigned long *)&p->counter, v,
+                                   __ATOMIC_SEQ_CST);
+}
+
+#endif /* VMSORT_SHIM_ATOMIC_H_ */
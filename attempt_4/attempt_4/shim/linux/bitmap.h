@@ -0,0 +1,96 @@
+/*
+ * shim/linux/bitmap.h  —  the <linux/bitmap.h> and bitops subset that
+ * vmsort_bm.h needs, with the kernel's semantics: set_bit and
+ * test_and_set_bit are atomic (lock‑prefixed on x86, as in the kernel),
+ * the __ variants are not, and find_next_bit scans a word at a time.
+ * 64‑bit longs only, like vmsort_bm.h itself.
+ */
+#ifndef VMSORT_SHIM_BITMAP_H_
+#define VMSORT_SHIM_BITMAP_H_
+
+#include <string.h>
+#include <linux/types.h>
+
+#define BITS_PER_LONG           64
+#define BIT_WORD(nr)            ((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr)            (1UL << ((nr) % BITS_PER_LONG))
+#define BITS_TO_LONGS(nr)       (((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits) unsigned long name[BITS_TO_LONGS(bits)]
+
+static inline unsigned long __ffs(unsigned long x) { return __builtin_ctzl(x); }
+static inline unsigned long __fls(unsigned long x) { return 63 - __builtin_clzl(x); }
+#define hweight_long(x)         ((unsigned)__builtin_popcountl(x))
+
+static inline bool test_bit(unsigned long nr, const unsigned long *addr)
+{
+        return addr[BIT_WORD(nr)] >> (nr % BITS_PER_LONG) & 1;
+}
+
+static inline void set_bit(unsigned long nr, unsigned long *addr)
+{
+        __atomic_fetch_or(addr + BIT_WORD(nr), BIT_MASK(nr), __ATOMIC_RELAXED);
+}
+
+static inline void clear_bit(unsigned long nr, unsigned long *addr)
+{
+        __atomic_fetch_and(addr + BIT_WORD(nr), ~BIT_MASK(nr), __ATOMIC_RELAXED);
+}
+
+static inline bool test_and_set_bit(unsigned long nr, unsigned long *addr)
+{
+        return __atomic_fetch_or(addr + BIT_WORD(nr), BIT_MASK(nr),
+                                 __ATOMIC_SEQ_CST) & BIT_MASK(nr);
+}
+
+static inline void __set_bit(unsigned long nr, unsigned long *addr)
+{
+        addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline void __clear_bit(unsigned long nr, unsigned long *addr)
+{
+        addr[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+}
+
+static inline unsigned long find_next_bit(const unsigned long *addr,
+                                          unsigned long size,
+                                          unsigned long off)
+{
+        unsigned long w;
+
+        if (off >= size)
+                return size;
+        w = addr[BIT_WORD(off)] & (~0UL << (off % BITS_PER_LONG));
+        for (off &= ~(BITS_PER_LONG - 1UL); !w; w = addr[BIT_WORD(off)])
+                if ((off += BITS_PER_LONG) >= size)
+                        return size;
+        off += __ffs(w);
+        return off < size ? off : size;
+}
+
+#define for_each_set_bit(bit, addr, size)                               \
+        for ((bit) = find_next_bit((addr), (size), 0);                  \
+             (bit) < (size);                                            \
+             (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+#define for_each_set_bit_from(bit, addr, size)                          \
+        for ((bit) = find_next_bit((addr), (size), (bit));              \
+             (bit) < (size);                                            \
+             (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+static inline void bitmap_zero(unsigned long *dst, unsigned int nbits)
+{
+        memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(unsigned long));
+}
+
+static inline unsigned int bitmap_weight(const unsigned long *src,
+                                         unsigned int nbits)
+{
+        unsigned int i, w = 0;
+
+        for (i = 0; i < BITS_TO_LONGS(nbits); ++i)
+                w += hweight_long(src[i]);
+        return w;
+}
+
+#endif /* VMSORT_SHIM_BITMAP_H_ */
@@ -0,0 +1,15 @@
+/* shim/linux/types.h  —  userspace stand‑in for vmsort_bm.h (make bench) */
+#ifndef VMSORT_SHIM_TYPES_H_
+#define VMSORT_SHIM_TYPES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define READ_ONCE(x)    (*(const volatile __typeof__(x) *)&(x))
+
+#endif /* VMSORT_SHIM_TYPES_H_ */
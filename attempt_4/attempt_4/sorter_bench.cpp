@@ -0,0 +1,90 @@
+// sorter_bench.cpp  —  vmsort::bitset_sorter vs std::sort and LSD radix
+//
+// N random keys (duplicates included) of 8, 16, 20 and 24 bits, sorted
+// to their unique set.  The sorter runs from an arena, reused across
+// repetitions with clear(), so no allocation is timed.
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "vmsort.hpp"
+
+static std::uint64_t xorshift64(std::uint64_t &s)
+{
+    s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+    return s;
+}
+
+template <class F>
+static double time_ns(F &&f, int reps)
+{
+    f();                                // warm caches and page tables
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i) f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / reps;
+}
+
+// LSD radix on 8-bit digits, then unique
+template <unsigned KeyBits>
+static std::size_t radix_unique(std::vector<std::uint32_t> &a, std::vector<std::uint32_t> &tmp)
+{
+    for (unsigned sh = 0; sh < KeyBits; sh += 8) {
+        std::size_t cnt[257] = {};
+        for (std::uint32_t k : a) ++cnt[(k >> sh & 0xFF) + 1];
+        for (int i = 0; i < 256; ++i) cnt[i + 1] += cnt[i];
+        for (std::uint32_t k : a) tmp[cnt[k >> sh & 0xFF]++] = k;
+        a.swap(tmp);
+    }
+    return std::unique(a.begin(), a.end()) - a.begin();
+}
+
+template <unsigned KeyBits, unsigned Levels = vmsort::detail::auto_levels<std::uint64_t>(KeyBits)>
+static void run(std::size_t n, int reps)
+{
+    using sorter = vmsort::bitset_sorter<KeyBits, Levels>;
+    std::vector<std::uint32_t> keys(n), a, tmp(n), ref;
+    std::uint64_t seed = 0x5eed ^ KeyBits;
+    for (auto &k : keys) k = xorshift64(seed) & ((1u << KeyBits) - 1);
+
+    ref = keys;
+    std::sort(ref.begin(), ref.end());
+    ref.erase(std::unique(ref.begin(), ref.end()), ref.end());
+
+    vmsort::arena ar(sorter::bytes + 64);
+    sorter s(ar);
+    std::vector<std::uint32_t> out(n);
+    std::size_t got = 0;
+    double t_bs = time_ns([&] {
+        s.clear();
+        for (std::uint32_t k : keys) s.insert(typename sorter::key_type(k));
+        got = s.extract(out.data()) - out.data();
+    }, reps);
+    assert(got == ref.size() && std::equal(ref.begin(), ref.end(), out.begin()));
+
+    double t_std = time_ns([&] {
+        a = keys;
+        std::sort(a.begin(), a.end());
+        got = std::unique(a.begin(), a.end()) - a.begin();
+    }, reps);
+    assert(got == ref.size());
+
+    double t_rdx = time_ns([&] {
+        a = keys;
+        got = radix_unique<KeyBits>(a, tmp);
+    }, reps);
+    assert(got == ref.size() && std::equal(ref.begin(), ref.end(), a.begin()));
+
+    std::printf("%2u-bit L=%u %8zu keys (%7zu unique): sorter %6.2f  std::sort %6.2f  radix %6.2f ns/key\n",
+                KeyBits, Levels, n, ref.size(), t_bs / n, t_std / n, t_rdx / n);
+}
+
+int main()
+{
+    run<8>(128, 20000);
+    run<16>(32768, 200);
+    run<16, 2>(32768, 200);             // the kernel's two-level layout
+    run<20>(1 << 19, 10);
+    run<24>(1 << 23, 2);
+    return 0;
+}
@@ -6,114 +6,1737 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
-#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/rwsem.h>
+#include <linux/srcu.h>
+#include <linux/file.h>
+#include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <linux/uio.h>
+#include <linux/splice.h>
+#include <linux/list_lru.h>
+#include <linux/shrinker.h>
+#include <linux/io_uring/cmd.h>
+#include "vmsort_uapi.h"
 #include "vmsort_bm.h"
+#include "vmsort_enc.h"
+#include "vmsort_stats.h"
+
+#define CREATE_TRACE_POINTS
+#include "vmsort_trace.h"
 
 #define DEV            "vmsort"
-#define WIN            (256UL << 20)     /* 256 MiB user window        */
-#define CHUNKS         128               /* 128 × 2 MiB  = 256 MiB     */
+#define WIN            (256UL << 20)     /* 256 MiB user window        */
+#define CHUNKS         128               /* 128 × 2 MiB  = 256 MiB     */
 #define CHUNK_PAGES    512               /* pages per chunk (order‑9)  */
+#define CHUNK_SMALL    1UL               /* tag: order‑0 fallback      */
 
-struct vmsort_iter { u64 ptr; u32 cap; u32 out; };
-#define VMSORT_IOCTL _IOWR('v', 1, struct vmsort_iter)
+/* struct fd is an opaque word read through fd_file() since 6.12 */
+#ifndef fd_file
+#define fd_file(f)     ((f).file)
+#endif
+
+/* ------------------------------------------------------------------ */
+/* Per‑open session                                                   */
+/*                                                                    */
+/* Two bitmap generations: faults set bits in bm[live]; the other one */
+/* holds the last snapshot.  A snapshot flips `live`, waits out the   */
+/* faults still in the old generation (SRCU, so faults never block),  */
+/* then ORs the frozen generation into the new live one.  snap_sem is */
+/* held shared while a generation is read, exclusively only for the   */
+/* flip.  Order: mmap_lock, then snap_sem (->mmap takes it under      */
+/* mmap_lock), so nothing copies to user memory with snap_sem held.   */
+/*                                                                    */
+/* Epoch mode reuses the flip but, instead of folding, unmaps the old */
+/* epoch's pages (so they fault again), hands its keys back and       */
+/* clears it.  A session is either snapshotting or epochal.           */
+/*                                                                    */
+/* The pinned output buffer (pin_*) is swapped under snap_sem held    */
+/* exclusively, so every extraction can use it under the shared lock. */
+/* rd_cursor remembers where the last read() stopped, so sequential   */
+/* reads resume without selecting by rank.                            */
+/*                                                                    */
+/* A session with no mapping left, or with a parked spare chunk, sits */
+/* on vmsort_lru (via its small, memcg‑charged lru node) so the       */
+/* shrinker can give its chunks back; see "Reclaim" below.            */
+/*                                                                    */
+/* `dirty` is an overlay of the keys new to the live set since the    */
+/* last DELTA read, set by the same fault (or INSERT) that set them.  */
+/* ------------------------------------------------------------------ */
+struct vmsort_session;
+
+struct vmsort_lru_node {
+        struct list_head        list;
+        struct vmsort_session  *s;
+};
+
+struct vmsort_session {
+        struct vmsort_bm     bm[2];              /* live / last snapshot    */
+        struct vmsort_bm     dirty;              /* new since last DELTA    */
+        unsigned             live;
+        u64                  snap_gen;
+        u64                  epoch;              /* flips, 0 = not epochal  */
+        unsigned long        win_base;           /* last mmap'd window      */
+        struct rw_semaphore  snap_sem;
+        struct srcu_struct   srcu;               /* faults inside bm_set    */
+        unsigned long        chunk_pool[CHUNKS]; /* page * | CHUNK_SMALL    */
+        unsigned long        spare;              /* lost install, recycled  */
+        struct page        **pin_pages;          /* pinned output, or NULL  */
+        void                *pin_map;            /* vmap of pin_pages       */
+        u16                 *pin_buf;            /* pin_map + page offset   */
+        u32                  pin_cap, pin_nr;
+        u64                  rd_cursor;          /* read(): rank << 32 | key */
+        atomic_t             maps;               /* live VMAs of the window */
+        struct vmsort_lru_node *lru;
+        DECLARE_BITMAP(reclaimed, CHUNKS);       /* freed by the shrinker   */
+        atomic_long_t        pages;              /* chunk pages held        */
+        unsigned long        budget;             /* page limit, 0 = none    */
+        struct page         *sink;               /* over‑budget backing     */
+        bool                 sunk;               /* sink mapped since reset */
+        struct vmsort_stats __percpu *stats;
+};
 
 /* ------------------------------------------------------------------ */
 /* Global state                                                       */
 /* ------------------------------------------------------------------ */
-static struct page   **chunk_pool;        /* [128] backing pages       */
-static struct vmsort_bm bitmap;           /* whole‑window bitmap       */
-static unsigned long   win_base;
 static int             major;
-static DEFINE_MUTEX(iter_lock);
+static struct page    *sink_page;         /* null‑handler backing page */
+static struct dentry  *dbg_dir;
+static struct list_lru    vmsort_lru;      /* reclaimable sessions      */
+static struct shrinker   *vmsort_shrinker;
+static struct kmem_cache *lru_cache;       /* SLAB_ACCOUNT lru nodes    */
+static DEFINE_PER_CPU(struct vmsort_stats, gstats);
+
+static bool null_fault;
+module_param(null_fault, bool, 0644);
+MODULE_PARM_DESC(null_fault,
+        "calibration: map one shared page, skip bitmap and allocation work");
+
+static unsigned int budget_mb;
+module_param(budget_mb, uint, 0644);
+MODULE_PARM_DESC(budget_mb,
+        "default per‑session chunk budget in MiB (0 = unlimited)");
+
+/* bump a counter both in the session and in the global debugfs view */
+#define vmsort_count(s, c, n) do {                                      \
+        this_cpu_add((s)->stats->ctr[c], n);                            \
+        this_cpu_add(gstats.ctr[c], n);                                 \
+} while (0)
+
+#define vmsort_hist(s, h, ns) do {                                      \
+        unsigned __b = vmsort_hist_bucket(ns);                          \
+        this_cpu_inc((s)->stats->hist[h][__b]);                         \
+        this_cpu_inc(gstats.hist[h][__b]);                              \
+} while (0)
+
+/* ------------------------------------------------------------------ */
+/* Chunk allocator                                                    */
+/*                                                                    */
+/* A chunk is 512 order‑0 pages split from one 2 MiB block, or one   */
+/* page tagged CHUNK_SMALL that backs every offset of the chunk when  */
+/* no 2 MiB block is available.                                       */
+/* Pages are reserved against the session budget before allocating;  */
+/* past it, or when the allocator says no, the fault maps s->sink.    */
+/* Installation is a cmpxchg on chunk_pool[]: racing faults on the    */
+/* same chunk all map the winner's pages and the loser parks its      */
+/* chunk in ->spare for the next allocation (or frees it).            */
+/* ------------------------------------------------------------------ */
+static inline struct page *chunk_page(unsigned long v)
+{
+        return (struct page *)(v & ~CHUNK_SMALL);
+}
+
+static void vmsort_chunk_free(struct vmsort_session *s, unsigned long v)
+{
+        struct page *p = chunk_page(v);
+        int i;
+
+        atomic_long_sub(v & CHUNK_SMALL ? 1 : CHUNK_PAGES, &s->pages);
+        if (v & CHUNK_SMALL) {
+                __free_page(p);
+                return;
+        }
+        for (i = 0; i < CHUNK_PAGES; ++i)
+                __free_page(p + i);
+}
+
+/* reserve @n pages against the budget */
+static bool vmsort_budget_take(struct vmsort_session *s, long n)
+{
+        unsigned long limit = READ_ONCE(s->budget);
+
+        if (atomic_long_add_return(n, &s->pages) <= limit || !limit)
+                return true;
+        atomic_long_sub(n, &s->pages);
+        return false;
+}
+
+/* returns the chunk now installed (ours or a racing winner's), or 0 */
+static unsigned long vmsort_chunk_alloc(struct vmsort_session *s,
+                                        unsigned chunk, int *order)
+{
+        u64 t0 = trace_vmsort_chunk_alloc_enabled() ? ktime_get_ns() : 0;
+        unsigned long v, old;
+        struct page *p;
+
+        v = xchg(&s->spare, 0);
+        if (v) {
+                *order = v & CHUNK_SMALL ? 0 : 9;
+                goto install;
+        }
+
+        p = NULL;
+        if (vmsort_budget_take(s, CHUNK_PAGES)) {
+                p = alloc_pages(GFP_KERNEL_ACCOUNT | __GFP_ZERO |
+                                __GFP_NORETRY | __GFP_NOWARN, 9); /* 2 MiB */
+                if (p) {
+                        split_page(p, 9);
+                        v = (unsigned long)p;
+                        *order = 9;
+                        vmsort_count(s, VS_ALLOC_HUGE, 1);
+                } else {
+                        atomic_long_sub(CHUNK_PAGES, &s->pages);
+                }
+        } else {
+                vmsort_count(s, VS_DEGRADE_SMALL, 1);
+        }
+        if (!p && vmsort_budget_take(s, 1)) {                /* fallback */
+                p = alloc_page(GFP_KERNEL_ACCOUNT | __GFP_ZERO |
+                               __GFP_NORETRY | __GFP_NOWARN);
+                if (p) {
+                        v = (unsigned long)p | CHUNK_SMALL;
+                        *order = 0;
+                        vmsort_count(s, VS_ALLOC_FALLBACK, 1);
+                } else {
+                        atomic_long_dec(&s->pages);
+                }
+        }
+        if (!p) {
+                *order = -1;
+                vmsort_count(s, VS_ALLOC_FAIL, 1);
+                trace_vmsort_chunk_alloc(chunk, -1, false, t0);
+                return 0;
+        }
+
+install:
+        old = cmpxchg(&s->chunk_pool[chunk], 0, v);
+        trace_vmsort_chunk_alloc(chunk, *order, !old, t0);
+        if (likely(!old)) {
+                if (unlikely(test_bit(chunk, s->reclaimed)) &&
+                    test_and_clear_bit(chunk, s->reclaimed))
+                        vmsort_count(s, VS_CHUNK_REALLOC, 1);
+                return v;
+        }
+
+        vmsort_count(s, VS_ALLOC_LOST, 1);
+        if (cmpxchg(&s->spare, 0, v))
+                vmsort_chunk_free(s, v);
+        else
+                list_lru_add_obj(&vmsort_lru, &s->lru->list);
+        return old;
+}
+
+/* ------------------------------------------------------------------ */
+/* Reclaim                                                            */
+/*                                                                    */
+/* Chunks stay pooled after munmap so a remap is cheap, but under     */
+/* pressure the shrinker frees every chunk of an unmapped session and */
+/* any parked spare.  The lru is memcg‑aware (nodes come from a       */
+/* SLAB_ACCOUNT cache and chunks are __GFP_ACCOUNT), so memory.high   */
+/* reclaim in the owning cgroup reaches them too.  Holding snap_sem   */
+/* for write with maps == 0 excludes mmap, and with it every fault;   */
+/* save/restore touch chunk pages under the read side.  The next      */
+/* fault simply allocates the chunk again.                            */
+/* ------------------------------------------------------------------ */
+static enum lru_status vmsort_isolate(struct list_head *item,
+                                      struct list_lru_one *list,
+                                      spinlock_t *lock, void *arg)
+{
+        struct vmsort_session *s =
+                container_of(item, struct vmsort_lru_node, list)->s;
+        unsigned long v, *freed = arg;
+        int i;
+
+        if (!down_write_trylock(&s->snap_sem))
+                return LRU_SKIP;
+        v = xchg(&s->spare, 0);
+        if (v)
+                vmsort_chunk_free(s, v);
+        if (!atomic_read(&s->maps))
+                for (i = 0; i < CHUNKS; ++i) {
+                        v = xchg(&s->chunk_pool[i], 0);
+                        if (!v)
+                                continue;
+                        vmsort_chunk_free(s, v);
+                        set_bit(i, s->reclaimed);
+                        vmsort_count(s, VS_CHUNK_RECLAIM, 1);
+                }
+        up_write(&s->snap_sem);
+
+        list_lru_isolate(list, item);
+        ++*freed;
+        return LRU_REMOVED;
+}
+
+static unsigned long vmsort_shrink_count(struct shrinker *sh,
+                                         struct shrink_control *sc)
+{
+        return list_lru_shrink_count(&vmsort_lru, sc) ?: SHRINK_EMPTY;
+}
+
+static unsigned long vmsort_shrink_scan(struct shrinker *sh,
+                                        struct shrink_control *sc)
+{
+        unsigned long freed = 0;
+
+        list_lru_shrink_walk(&vmsort_lru, sc, vmsort_isolate, &freed);
+        return freed ?: SHRINK_STOP;
+}
 
 /* ------------------------------------------------------------------ */
 static vm_fault_t vmsort_fault(struct vm_fault *vmf)
 {
-        unsigned off   = (vmf->address - win_base) >> PAGE_SHIFT; /* 0‑65535 */
+        struct vmsort_session *s = vmf->vma->vm_private_data;
+        unsigned off   = vmf->pgoff;    /* survives VMA splits: 0‑65535 */
         unsigned chunk = off / CHUNK_PAGES;
+        u64 t0 = ktime_get_ns();
+        struct page *page;
+        unsigned long v;
+        int order = -1, idx;
+        vm_fault_t ret;
+        bool new;
 
-        /* mark page present (lock‑free) */
-        vmsort_bm_set(&bitmap, (u16)off);
+        if (READ_ONCE(null_fault)) {
+                ret = vmf_insert_pfn(vmf->vma, vmf->address,
+                                     page_to_pfn(sink_page));
+                vmsort_count(s, VS_FAULT_NULL, 1);
+                goto out;
+        }
 
         /* lazily allocate backing page if chunk empty */
-        if (unlikely(!chunk_pool[chunk])) {
-                struct page *p = alloc_pages(GFP_KERNEL | __GFP_ZERO |
-                                             __GFP_NORETRY | __GFP_NOWARN,
-                                             9);          /* try 2 MiB   */
-                if (!p)                                     /* fallback   */
-                        p = alloc_page(GFP_KERNEL | __GFP_ZERO);
-                if (!p) return VM_FAULT_OOM;
-                chunk_pool[chunk] = p;
+        v = READ_ONCE(s->chunk_pool[chunk]);
+        if (unlikely(!v))
+                v = vmsort_chunk_alloc(s, chunk, &order);
+        if (likely(v)) {
+                page = chunk_page(v) +
+                       (v & CHUNK_SMALL ? 0 : off & (CHUNK_PAGES - 1));
+        } else {
+                /* degrade, never fail: the key is still recorded */
+                page = s->sink;
+                WRITE_ONCE(s->sunk, true);
+                vmsort_count(s, VS_DEGRADE_SINK, 1);
         }
 
-        vmf->page = chunk_pool[chunk] + (off & (CHUNK_PAGES - 1));
-        get_page(vmf->page);
-        SetPageDirty(vmf->page);
-        return 0;                       /* VM_FAULT_NOPAGE (==0)       */
+        /*
+         * mark page present (lock‑free) and map it in one SRCU section:
+         * once a flip has waited us out, our bit and our PTE are both
+         * visible, so an epoch flip can zap exactly what the old epoch set
+         */
+        idx = srcu_read_lock(&s->srcu);
+        new = vmsort_bm_set(&s->bm[READ_ONCE(s->live)], (u16)off);
+        if (new)
+                vmsort_bm_set(&s->dirty, (u16)off);
+        ret = vmf_insert_pfn(vmf->vma, vmf->address, page_to_pfn(page));
+        srcu_read_unlock(&s->srcu, idx);
+
+        if (new)
+                vmsort_count(s, VS_BM_NEW, 1);
+        else
+                vmsort_count(s, VS_BM_DUP, 1);
+        trace_vmsort_fault((u16)off, chunk, order >= 0, order);
+out:
+        vmsort_count(s, VS_FAULT, 1);
+        vmsort_hist(s, VH_FAULT, ktime_get_ns() - t0);
+        return ret;                     /* VM_FAULT_NOPAGE             */
+}
+
+/* split or forked VMAs; the last one gone makes the session reclaimable */
+static void vmsort_vm_open(struct vm_area_struct *vma)
+{
+        struct vmsort_session *s = vma->vm_private_data;
+
+        atomic_inc(&s->maps);
+}
+
+static void vmsort_vm_close(struct vm_area_struct *vma)
+{
+        struct vmsort_session *s = vma->vm_private_data;
+
+        if (atomic_dec_and_test(&s->maps))
+                list_lru_add_obj(&vmsort_lru, &s->lru->list);
 }
 
 static const struct vm_operations_struct vm_ops = {
+        .open  = vmsort_vm_open,
+        .close = vmsort_vm_close,
         .fault = vmsort_fault,
 };
 
+/* ------------------------------------------------------------------ */
+/* Pinned output buffer                                               */
+/*                                                                    */
+/* Repeated sorts into the same user buffer skip the on‑stack bounce  */
+/* and copy_to_user: the buffer is pinned once and vmapped, and       */
+/* PIN_READ decodes into it directly.  At most 65536 keys (33 pages)  */
+/* are ever pinned per session.                                       */
+/* ------------------------------------------------------------------ */
+static void vmsort_unpin(struct page **pages, void *map, u32 nr)
+{
+        if (!pages)
+                return;
+        vunmap(map);
+        unpin_user_pages_dirty_lock(pages, nr, true);
+        kvfree(pages);
+}
+
+static long vmsort_pin(struct vmsort_session *s, struct vmsort_pin *p)
+{
+        struct page **pages = NULL, **old_pages;
+        void *map = NULL, *old_map;
+        unsigned long first = p->ptr & PAGE_MASK;
+        u32 nr = 0, old_nr;
+        int got;
+
+        if (p->ptr) {
+                if (!p->cap || p->cap > 65536 || p->ptr & 1)
+                        return -EINVAL;
+                nr = DIV_ROUND_UP(p->ptr + p->cap * sizeof(u16) - first,
+                                  PAGE_SIZE);
+                pages = kvmalloc_array(nr, sizeof(*pages), GFP_KERNEL);
+                if (!pages)
+                        return -ENOMEM;
+                got = pin_user_pages_fast(first, nr,
+                                          FOLL_WRITE | FOLL_LONGTERM, pages);
+                if (got != nr) {
+                        if (got > 0)
+                                unpin_user_pages(pages, got);
+                        kvfree(pages);
+                        return got < 0 ? got : -EFAULT;
+                }
+                map = vmap(pages, nr, VM_MAP, PAGE_KERNEL);
+                if (!map) {
+                        unpin_user_pages(pages, nr);
+                        kvfree(pages);
+                        return -ENOMEM;
+                }
+        }
+
+        down_write(&s->snap_sem);
+        old_pages    = s->pin_pages;
+        old_map      = s->pin_map;
+        old_nr       = s->pin_nr;
+        s->pin_pages = pages;
+        s->pin_map   = map;
+        s->pin_buf   = map ? map + offset_in_page(p->ptr) : NULL;
+        s->pin_cap   = map ? p->cap : 0;
+        s->pin_nr    = nr;
+        up_write(&s->snap_sem);
+
+        vmsort_unpin(old_pages, old_map, old_nr);
+        if (map)
+                vmsort_count(s, VS_PIN, 1);
+        p->pages = nr;
+        return 0;
+}
+
+/* decode [r->lo, r->hi) into pin_buf[r->ptr ...]; snap_sem held shared */
+static long vmsort_pin_read(struct vmsort_session *s,
+                            const struct vmsort_bm *bm, struct vmsort_range *r)
+{
+        u64 t0 = ktime_get_ns();
+        u32 pos = r->lo, cap;
+        u16 *dst;
+
+        if (!s->pin_buf)
+                return -ENXIO;
+        if (r->ptr > s->pin_cap)
+                return -EINVAL;
+        dst   = s->pin_buf + r->ptr;
+        cap   = min_t(u32, r->cap, s->pin_cap - r->ptr);
+        r->out = vmsort_bm_decode(bm, &pos, r->hi, dst, cap);
+        flush_kernel_vmap_range(dst, r->out * sizeof(u16));
+
+        vmsort_count(s, VS_EXTRACT, 1);
+        vmsort_count(s, VS_EXTRACT_KEYS, r->out);
+        vmsort_count(s, VS_PIN_EXTRACT, 1);
+        vmsort_hist(s, VH_SCAN, ktime_get_ns() - t0);
+        trace_vmsort_extract(r->out, (u64)r->out * sizeof(u16),
+                             DIV_ROUND_UP(pos - (r->lo & ~63U), 64));
+        return 0;
+}
+
+/* ------------------------------------------------------------------ */
+static int vmsort_open(struct inode *ino, struct file *f)
+{
+        struct vmsort_session *s = kvzalloc(sizeof(*s), GFP_KERNEL);
+
+        if (!s) return -ENOMEM;
+        s->stats = alloc_percpu(struct vmsort_stats);
+        s->lru   = kmem_cache_alloc_lru(lru_cache, &vmsort_lru, GFP_KERNEL);
+        s->sink  = alloc_page(GFP_KERNEL_ACCOUNT | __GFP_ZERO);
+        if (!s->stats || !s->lru || !s->sink || init_srcu_struct(&s->srcu)) {
+                if (s->sink) __free_page(s->sink);
+                if (s->lru) kmem_cache_free(lru_cache, s->lru);
+                free_percpu(s->stats); kvfree(s); return -ENOMEM;
+        }
+        s->budget = (unsigned long)READ_ONCE(budget_mb) << (20 - PAGE_SHIFT);
+        INIT_LIST_HEAD(&s->lru->list);
+        s->lru->s = s;
+        vmsort_bm_init(&s->bm[0]);
+        vmsort_bm_init(&s->bm[1]);
+        vmsort_bm_init(&s->dirty);
+        init_rwsem(&s->snap_sem);
+        f->private_data = s;
+        return 0;
+}
+
+static int vmsort_release(struct inode *ino, struct file *f)
+{
+        struct vmsort_session *s = f->private_data;
+        int i;
+
+        list_lru_del_obj(&vmsort_lru, &s->lru->list);   /* waits out isolate */
+        kmem_cache_free(lru_cache, s->lru);
+        for (i = 0; i < CHUNKS; ++i)
+                if (s->chunk_pool[i])
+                        vmsort_chunk_free(s, s->chunk_pool[i]);
+        if (s->spare)
+                vmsort_chunk_free(s, s->spare);
+        __free_page(s->sink);
+        vmsort_unpin(s->pin_pages, s->pin_map, s->pin_nr);
+        cleanup_srcu_struct(&s->srcu);
+        free_percpu(s->stats);
+        kvfree(s);
+        return 0;
+}
+
 /* ------------------------------------------------------------------ */
 static int vmsort_mmap(struct file *f, struct vm_area_struct *vma)
 {
-        if (vma->vm_end - vma->vm_start != WIN)
+        struct vmsort_session *s = f->private_data;
+
+        /* the key is the page offset: the window starts at key 0 */
+        if (vma->vm_end - vma->vm_start != WIN || vma->vm_pgoff)
+                return -EINVAL;
+        if (!(vma->vm_flags & VM_SHARED))       /* no COW of PFN maps */
                 return -EINVAL;
 
-        vmsort_bm_init(&bitmap);
-        memset(chunk_pool, 0, sizeof(struct page *) * CHUNKS);
+        /* fresh key set; chunks already in the pool are reused */
+        down_write(&s->snap_sem);
+        vmsort_bm_init(&s->bm[0]);
+        vmsort_bm_init(&s->bm[1]);
+        vmsort_bm_init(&s->dirty);
+        s->live     = 0;
+        s->snap_gen = 0;
+        s->epoch    = 0;
+        s->win_base = vma->vm_start;
+        s->rd_cursor = 0;
+        atomic_inc(&s->maps);
+        up_write(&s->snap_sem);
+        list_lru_del_obj(&vmsort_lru, &s->lru->list);
 
-        win_base    = vma->vm_start;
-        vma->vm_ops = &vm_ops;
+        /* PTEs via vmf_insert_pfn so epoch flips can zap_vma_ptes() */
+        vm_flags_set(vma, VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP);
+        vma->vm_private_data = s;
+        vma->vm_ops          = &vm_ops;
         return 0;
 }
 
 /* ------------------------------------------------------------------ */
 /* zero‑copy, buffered iterator  (O(n))                               */
+/*                                                                    */
+/* Decodes [lo, hi) in 1024‑key batches with a local cursor and no    */
+/* shared state: several threads may extract disjoint ranges at once  */
+/* straight into their final offsets (from VMSORT_IOC_COUNT).  Stops  */
+/* at cap, so bottom‑N (and, descending, top‑N) reads only the words  */
+/* holding those N keys plus the empty ones skipped on the way.       */
+/*                                                                    */
+/* ->mmap takes snap_sem under mmap_lock, so no copy to user memory   */
+/* (which may fault and take mmap_lock) runs with snap_sem held: the  */
+/* live set is decoded one batch at a time under the shared lock and  */
+/* each batch copied after dropping it, and frozen generations are    */
+/* copied out privately first (vmsort_copy_bm).                       */
 /* ------------------------------------------------------------------ */
-static long vmsort_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+
+/* one batch from *pos; bm == NULL is the live set, under snap_sem */
+static u32 vmsort_batch(struct vmsort_session *s, const struct vmsort_bm *bm,
+                        u32 *pos, u32 lo, u32 hi, u16 *buf, u32 cap,
+                        bool desc)
 {
-        if (cmd != VMSORT_IOCTL) return -ENOTTY;
+        bool live = !bm;
+        u32 fill;
 
-        struct vmsort_iter it;
-        if (copy_from_user(&it, (void __user *)arg, sizeof(it)))
-                return -EFAULT;
+        if (live) {
+                down_read(&s->snap_sem);
+                bm = &s->bm[s->live];
+        }
+        if (desc)
+                fill = vmsort_bm_decode_rev(bm, pos, lo, buf, cap);
+        else
+                fill = vmsort_bm_decode(bm, pos, hi, buf, cap);
+        if (live)
+                up_read(&s->snap_sem);
+        return fill;
+}
 
-        u32 out = 0;        /* keys emitted so far */
+/* private copy of @bm's populated words (l0 outside l1 unset); the
+   caller keeps @bm stable                                           */
+static struct vmsort_bm *vmsort_copy_bm(const struct vmsort_bm *bm)
+{
+        struct vmsort_bm *cp = kvmalloc(sizeof(*cp), GFP_KERNEL);
+        u32 w;
+
+        if (!cp)
+                return NULL;
+        bitmap_copy(cp->l1, bm->l1, 1024);
+        for_each_set_bit(w, cp->l1, 1024)
+                cp->l0[w] = READ_ONCE(bm->l0[w]);
+        return cp;
+}
+
+/* bm: a private bitmap, or NULL for the live set; no lock held */
+static long vmsort_extract_dir(struct vmsort_session *s,
+                               const struct vmsort_bm *bm, u32 lo, u32 hi,
+                               u16 __user *dst, u32 cap, u32 *outp,
+                               bool desc)
+{
         u16 buf[1024];      /* batch buffer        */
-        u32 fill = 0;       /* number in buffer    */
-        u16 key;
+        u32 out = 0;        /* keys emitted so far */
+        u32 fill, pos = desc ? hi : lo;
+        u64 t0 = ktime_get_ns(), tc, copy_ns = 0;
+
+        while (out < cap && (desc ? pos > lo : pos < hi)) {
+                fill = vmsort_batch(s, bm, &pos, lo, hi, buf,
+                                    min(cap - out, 1024U), desc);
+                tc = ktime_get_ns();
+                if (fill && copy_to_user(dst + out, buf, fill * sizeof(u16)))
+                        return -EFAULT;
+                copy_ns += ktime_get_ns() - tc;
+                out += fill;
+        }
+
+        vmsort_count(s, VS_EXTRACT, 1);
+        vmsort_count(s, VS_EXTRACT_KEYS, out);
+        vmsort_hist(s, VH_SCAN, ktime_get_ns() - t0 - copy_ns);
+        vmsort_hist(s, VH_COPY, copy_ns);
+        trace_vmsort_extract(out, (u64)out * sizeof(u16),
+                             desc ? DIV_ROUND_UP(hi, 64) - pos / 64
+                                  : DIV_ROUND_UP(pos - (lo & ~63U), 64));
+        *outp = out;
+        return 0;
+}
+
+static long vmsort_extract(struct vmsort_session *s,
+                           const struct vmsort_bm *bm, u32 lo, u32 hi,
+                           u16 __user *dst, u32 cap, u32 *outp)
+{
+        return vmsort_extract_dir(s, bm, lo, hi, dst, cap, outp, false);
+}
 
-        mutex_lock(&iter_lock);
-        vmsort_bm_reset_iter(&bitmap);
+/* ------------------------------------------------------------------ */
+/* Segmented extraction                                               */
+/*                                                                    */
+/* One sorted walk of the whole set serves every segment: a key's     */
+/* segment is key >> shift, so offsets fall out of the walk as the    */
+/* segment index steps up, and empty segments (no l1 bits in their    */
+/* range) cost nothing.  Keys leave as local keys, key & (W - 1).     */
+/* ------------------------------------------------------------------ */
+static int vmsort_reset(struct vmsort_session *s);
+
+static long vmsort_segments(struct vmsort_session *s, struct vmsort_seg *sg)
+{
+        u16 __user *dst = (u16 __user *)(uintptr_t)sg->ptr;
+        u32 nseg, seg = 0, pos = 0, out = 0, fill, i, mask;
+        u16 buf[1024];
+        u32 *offs;
+        long ret = 0;
+
+        if (sg->shift > 16 || sg->flags & ~VMSORT_SEG_RESET)
+                return -EINVAL;
+        nseg = 65536 >> sg->shift;
+        mask = (1U << sg->shift) - 1;
+        offs = kvmalloc_array(nseg + 1, sizeof(u32), GFP_KERNEL);
+        if (!offs)
+                return -ENOMEM;
 
-        while (out < it.cap && !vmsort_bm_next(&bitmap, &key)) {
-                buf[fill++] = key;
-                if (fill == 1024) {
-                        if (copy_to_user((u16 __user *)(uintptr_t)it.ptr + out,
-                                         buf, 1024 * sizeof(u16)))
-                                { mutex_unlock(&iter_lock); return -EFAULT; }
-                        out  += 1024;
-                        fill  = 0;
+        down_read(&s->snap_sem);
+        sg->out = vmsort_bm_count(&s->bm[s->live], 0, 65536);
+        up_read(&s->snap_sem);
+        if (sg->out > sg->cap) {
+                ret = -ENOSPC;
+                goto out;
+        }
+        /* keys faulted in after the count are dropped at cap */
+        while ((fill = vmsort_batch(s, NULL, &pos, 0, 65536, buf,
+                                    min(sg->cap - out, 1024U), false))) {
+                for (i = 0; i < fill; ++i) {
+                        while (seg <= buf[i] >> sg->shift)
+                                offs[seg++] = out + i;
+                        buf[i] &= mask;
+                }
+                if (copy_to_user(dst + out, buf, fill * sizeof(u16))) {
+                        ret = -EFAULT;
+                        break;
+                }
+                out += fill;
+        }
+        if (ret)
+                goto out;
+        while (seg <= nseg)
+                offs[seg++] = out;
+        sg->out = out;
+        if (copy_to_user((u32 __user *)(uintptr_t)sg->offs, offs,
+                         (nseg + 1) * sizeof(u32))) {
+                ret = -EFAULT;
+                goto out;
+        }
+
+        vmsort_count(s, VS_SEGMENTS, 1);
+        vmsort_count(s, VS_EXTRACT_KEYS, out);
+        if (sg->flags & VMSORT_SEG_RESET)
+                ret = vmsort_reset(s);
+out:
+        kvfree(offs);
+        return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/* read() / splice() streaming                                        */
+/*                                                                    */
+/* The fd reads as the live key set in ascending order, __u16 each;   */
+/* the file position is 2 × the rank of the next key.  copy_splice_   */
+/* read on top of this gives splice() and sendfile() for free.  Keys  */
+/* inserted below the cursor mid‑stream are not seen, as with any     */
+/* growing file; snapshot first for a stable stream.                  */
+/* ------------------------------------------------------------------ */
+static ssize_t vmsort_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+        struct vmsort_session *s = iocb->ki_filp->private_data;
+        u16 buf[1024];
+        u64 t0 = ktime_get_ns(), tc, copy_ns = 0, cur;
+        u32 rank, pos, fill, want;
+        size_t done = 0, n;
+        bool fault = false;
+
+        if (iocb->ki_pos & 1)
+                return -EINVAL;
+        if (iocb->ki_pos >= 65536 * sizeof(u16))
+                return 0;
+        rank = iocb->ki_pos / sizeof(u16);
+
+        cur = READ_ONCE(s->rd_cursor);
+        if (!rank) {
+                pos = 0;
+        } else if (cur >> 32 == rank) {
+                pos = (u32)cur;
+        } else {
+                down_read(&s->snap_sem);
+                pos = vmsort_bm_select(&s->bm[s->live], rank);
+                up_read(&s->snap_sem);
+                vmsort_count(s, VS_READ_SEEK, 1);
+        }
+
+        /* copy_to_iter may fault: each batch is decoded under snap_sem
+           and copied without it, as in vmsort_extract_dir            */
+        while (pos < 65536 && (want = iov_iter_count(to) / sizeof(u16))) {
+                fill = vmsort_batch(s, NULL, &pos, 0, 65536, buf,
+                                    min(want, 1024U), false);
+                if (!fill)
+                        break;
+                tc = ktime_get_ns();
+                n  = copy_to_iter(buf, fill * sizeof(u16), to);
+                copy_ns += ktime_get_ns() - tc;
+                done += n;
+                if (n != fill * sizeof(u16)) {
+                        /* resume at the first key not delivered */
+                        pos   = buf[n / sizeof(u16)];
+                        fault = true;
+                        break;
                 }
         }
-        if (fill &&
-            copy_to_user((u16 __user *)(uintptr_t)it.ptr + out,
-                         buf, fill * sizeof(u16)))
-                { mutex_unlock(&iter_lock); return -EFAULT; }
-        out += fill;
-        mutex_unlock(&iter_lock);
 
-        it.out = out;
-        return copy_to_user((void __user *)arg, &it, sizeof(it)) ? -EFAULT : 0;
+        rank += done / sizeof(u16);
+        WRITE_ONCE(s->rd_cursor, (u64)rank << 32 | pos);
+        iocb->ki_pos += done & ~1UL;
+
+        vmsort_count(s, VS_READ, 1);
+        vmsort_count(s, VS_EXTRACT_KEYS, done / sizeof(u16));
+        vmsort_hist(s, VH_SCAN, ktime_get_ns() - t0 - copy_ns);
+        vmsort_hist(s, VH_COPY, copy_ns);
+        if (!done && fault)
+                return -EFAULT;
+        return done & ~1UL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Delta extraction                                                   */
+/*                                                                    */
+/* Walks only the dirty overlay, so the cost is its 16 l1 words plus  */
+/* the new keys.  Each l1 bit is cleared before its l0 word is taken  */
+/* with xchg: a fault sets l0 before l1, so a key set concurrently is */
+/* either taken now or leaves l1 set for the next call.  Keys beyond  */
+/* cap, or in a batch that fails to copy, are put back.  Concurrent   */
+/* DELTA callers split the new keys between them.                     */
+/* ------------------------------------------------------------------ */
+static long vmsort_delta(struct vmsort_session *s, struct vmsort_iter *it)
+{
+        u16 __user *dst = (u16 __user *)(uintptr_t)it->ptr;
+        struct vmsort_bm *d = &s->dirty;
+        unsigned long bits, keep;
+        u32 w, i, n = 0, out = 0, room;
+        u16 buf[1024];
+
+        for_each_set_bit(w, d->l1, 1024) {
+                room = it->cap - out - n;
+                if (!room)
+                        break;
+                clear_bit(w, d->l1);
+                bits = atomic_long_xchg((atomic_long_t *)&d->l0[w], 0);
+                if (hweight_long(bits) > room) {
+                        for (keep = bits, i = 0; i < room; ++i)
+                                keep &= keep - 1;
+                        bits ^= keep;
+                        atomic_long_or(keep, (atomic_long_t *)&d->l0[w]);
+                        set_bit(w, d->l1);
+                }
+                for (; bits; bits &= bits - 1)
+                        buf[n++] = (w << 6) | __ffs(bits);
+                if (n <= ARRAY_SIZE(buf) - 64)
+                        continue;
+                if (copy_to_user(dst + out, buf, n * sizeof(u16)))
+                        goto fault;
+                out += n;
+                n = 0;
+        }
+        if (n && copy_to_user(dst + out, buf, n * sizeof(u16)))
+                goto fault;
+        out += n;
+done:
+        it->out = out;
+        vmsort_count(s, VS_DELTA, 1);
+        vmsort_count(s, VS_EXTRACT_KEYS, out);
+        return 0;
+fault:
+        /* earlier batches were delivered: report them, keep this one */
+        for (i = 0; i < n; ++i)
+                vmsort_bm_set(d, buf[i]);
+        if (out)
+                goto done;
+        return -EFAULT;
+}
+
+/* ------------------------------------------------------------------ */
+/* Snapshots                                                          */
+/* ------------------------------------------------------------------ */
+/* take a new generation; returns with snap_sem held shared */
+static void vmsort_snapshot(struct vmsort_session *s)
+{
+        u64 t0 = ktime_get_ns();
+        unsigned old;
+
+        down_write(&s->snap_sem);
+        old = s->live;
+        WRITE_ONCE(s->live, !old);
+        synchronize_srcu_expedited(&s->srcu);   /* bm[old] now frozen */
+        vmsort_bm_or(&s->bm[!old], &s->bm[old]);
+        ++s->snap_gen;
+        downgrade_write(&s->snap_sem);
+
+        vmsort_count(s, VS_SNAPSHOT, 1);
+        vmsort_hist(s, VH_SNAP, ktime_get_ns() - t0);
+}
+
+/* ------------------------------------------------------------------ */
+/* Window helpers                                                     */
+/* ------------------------------------------------------------------ */
+/* the session's current window in @mm; mmap_lock held */
+static struct vm_area_struct *vmsort_window(struct vmsort_session *s,
+                                            struct mm_struct *mm)
+{
+        struct vm_area_struct *vma = vma_lookup(mm, s->win_base);
+
+        if (!vma || vma->vm_ops != &vm_ops || vma->vm_private_data != s ||
+            vma->vm_end - vma->vm_start != WIN)
+                return NULL;
+        return vma;
+}
+
+static int vmsort_pte_none(pte_t *pte, unsigned long addr, void *data)
+{
+        return 0;
+}
+
+/*
+ * A first touch in a fresh window may have to allocate its PUD, PMD
+ * and PTE pages before vmsort_fault even runs.  apply_to_page_range()
+ * builds all of them for the window (128 PTE pages for 256 MiB) and
+ * leaves every leaf empty, so faults only fill leaves.  Under the read
+ * side of mmap_lock, like the faults that may race with it.
+ */
+static long vmsort_prepare(struct vmsort_session *s)
+{
+        struct mm_struct *mm = current->mm;
+        struct vm_area_struct *vma;
+        long ret;
+
+        mmap_read_lock(mm);
+        vma = vmsort_window(s, mm);
+        ret = vma ? apply_to_page_range(mm, vma->vm_start, WIN,
+                                        vmsort_pte_none, NULL) : -ENXIO;
+        mmap_read_unlock(mm);
+
+        vmsort_count(s, VS_PREPARE, 1);
+        return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/* Epochs                                                             */
+/* ------------------------------------------------------------------ */
+/*
+ * Redirect new faults to the other generation, zap the PTEs of every
+ * 64‑key block the old epoch touched (only those, via its l1), then
+ * extract the old epoch into sn->ptr and clear it the same way.  Writes
+ * racing with the flip land in one of the two epochs; every write after
+ * it returns faults into the new one.
+ */
+static long vmsort_epoch_flip(struct vmsort_session *s,
+                              struct vmsort_snap *sn)
+{
+        struct mm_struct *mm = current->mm;
+        struct vm_area_struct *vma;
+        struct vmsort_bm *old, *cp;
+        u64 t0 = ktime_get_ns();
+        long ret = 0;
+        u32 w;
+
+        if (s->snap_gen)
+                return -EBUSY;
+
+        mmap_read_lock(mm);
+        vma = vmsort_window(s, mm);
+        if (!vma) {
+                mmap_read_unlock(mm);
+                return -ENXIO;          /* flip from the mapping process */
+        }
+
+        down_write(&s->snap_sem);
+        old = &s->bm[s->live];
+        WRITE_ONCE(s->live, !s->live);
+        synchronize_srcu_expedited(&s->srcu);   /* old epoch now frozen */
+        for_each_set_bit(w, old->l1, 1024)
+                zap_vma_ptes(vma, vma->vm_start +
+                             ((unsigned long)w << (6 + PAGE_SHIFT)),
+                             64UL << PAGE_SHIFT);
+        WRITE_ONCE(s->epoch, s->epoch + 1);
+        WRITE_ONCE(s->rd_cursor, 0);
+        downgrade_write(&s->snap_sem);
+        mmap_read_unlock(mm);
+
+        sn->gen  = s->epoch;
+        sn->keys = bitmap_weight(old->l0, 65536);
+        sn->out  = 0;
+        cp = sn->ptr ? vmsort_copy_bm(old) : NULL;
+        vmsort_bm_clear(old);
+        up_read(&s->snap_sem);
+
+        /* copied out after the unlock: copy_to_user may fault */
+        if (sn->ptr && !cp)
+                ret = -ENOMEM;
+        else if (cp)
+                ret = vmsort_extract(s, cp, 0, 65536,
+                                     (u16 __user *)(uintptr_t)sn->ptr,
+                                     sn->cap, &sn->out);
+        kvfree(cp);
+
+        vmsort_count(s, VS_EPOCH, 1);
+        vmsort_hist(s, VH_SNAP, ktime_get_ns() - t0);
+        return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/* Set algebra                                                        */
+/* ------------------------------------------------------------------ */
+static const struct file_operations fops;
+
+/*
+ * Fold the sources into a private bitmap one at a time, each under its
+ * own snap_sem, so no two sessions' locks are ever held together; then
+ * optionally install the result as this session's live key set.
+ */
+static long vmsort_setop(struct vmsort_session *s, struct vmsort_setop *op)
+{
+        struct vmsort_bm *r;
+        s32 fds[VMSORT_SETOP_MAX];
+        long ret = 0;
+        u32 i;
+
+        BUILD_BUG_ON(VMSORT_SET_AND    != VMSORT_BM_AND    ||
+                     VMSORT_SET_OR     != VMSORT_BM_OR     ||
+                     VMSORT_SET_ANDNOT != VMSORT_BM_ANDNOT ||
+                     VMSORT_SET_XOR    != VMSORT_BM_XOR);
+
+        if (!op->nsrc || op->nsrc > VMSORT_SETOP_MAX ||
+            op->op > VMSORT_SET_XOR || op->flags & ~VMSORT_SET_STORE)
+                return -EINVAL;
+        if ((op->flags & VMSORT_SET_STORE) && READ_ONCE(s->epoch))
+                return -EBUSY;
+        if (copy_from_user(fds, (void __user *)(uintptr_t)op->srcs,
+                           op->nsrc * sizeof(s32)))
+                return -EFAULT;
+
+        r = kvzalloc(sizeof(*r), GFP_KERNEL);
+        if (!r) return -ENOMEM;
+
+        for (i = 0; i < op->nsrc; ++i) {
+                struct fd sf = fdget(fds[i]);
+                struct vmsort_session *src;
+
+                if (!fd_file(sf) || fd_file(sf)->f_op != &fops) {
+                        fdput(sf);
+                        ret = -EBADF;
+                        goto out;
+                }
+                src = fd_file(sf)->private_data;
+                down_read(&src->snap_sem);
+                vmsort_bm_combine(r, &src->bm[src->live],
+                                  i ? op->op : VMSORT_BM_OR);
+                up_read(&src->snap_sem);
+                fdput(sf);
+        }
+
+        op->card = bitmap_weight(r->l0, 65536);
+        op->out  = 0;
+
+        if (op->flags & VMSORT_SET_STORE) {
+                struct mm_struct *mm = current->mm;
+                struct vm_area_struct *vma;
+                struct vmsort_bm *live;
+                DECLARE_BITMAP(l1, 1024);
+                DECLARE_BITMAP(gone, 1024);
+                unsigned long old, keep;
+                u32 w;
+
+                /*
+                 * A key dropped from the set keeps its PTE, so its next
+                 * touch would not fault and the key would stay lost.  As
+                 * in vmsort_reset, zap the 64‑key blocks that lose keys
+                 * once faults racing with the swap have drained.  Faults
+                 * take no lock and set l0 before l1, so take l1 first and
+                 * then each of its l0 words with xchg: a bit set before
+                 * its word is taken is seen there, one set after keeps
+                 * both its bits (and its PTE) in the new set.
+                 */
+                mmap_read_lock(mm);
+                vma = vmsort_window(s, mm);
+                if (!vma && atomic_read(&s->maps)) {
+                        mmap_read_unlock(mm);
+                        ret = -ENXIO;
+                        goto out;
+                }
+                down_write(&s->snap_sem);
+                live = &s->bm[s->live];
+                for (w = 0; w < BITS_TO_LONGS(1024); ++w)
+                        l1[w] = xchg(&live->l1[w], 0);
+                bitmap_zero(gone, 1024);
+                for_each_set_bit(w, l1, 1024) {
+                        old  = xchg(&live->l0[w], 0);
+                        keep = test_bit(w, r->l1) ? r->l0[w] : 0;
+                        if (old & ~keep)
+                                __set_bit(w, gone);
+                }
+                vmsort_bm_or(live, r);
+                WRITE_ONCE(s->rd_cursor, 0);
+                if (vma && !bitmap_empty(gone, 1024)) {
+                        synchronize_srcu_expedited(&s->srcu);
+                        for_each_set_bit(w, gone, 1024)
+                                zap_vma_ptes(vma, vma->vm_start +
+                                             ((unsigned long)w << (6 + PAGE_SHIFT)),
+                                             64UL << PAGE_SHIFT);
+                }
+                up_write(&s->snap_sem);
+                mmap_read_unlock(mm);
+        }
+        if (op->ptr)
+                ret = vmsort_extract(s, r, 0, 65536,
+                                     (u16 __user *)(uintptr_t)op->ptr,
+                                     op->cap, &op->out);
+        vmsort_count(s, VS_SETOP, 1);
+out:
+        kvfree(r);
+        return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/* Encoded extraction                                                 */
+/* ------------------------------------------------------------------ */
+/* private copy of the live set's populated words (l0 outside l1 unset) */
+static struct vmsort_bm *vmsort_copy_live(struct vmsort_session *s)
+{
+        struct vmsort_bm *cp;
+
+        down_read(&s->snap_sem);
+        cp = vmsort_copy_bm(&s->bm[s->live]);
+        up_read(&s->snap_sem);
+        return cp;
+}
+
+static long vmsort_encode(struct vmsort_session *s, struct vmsort_enc *e)
+{
+        struct vmsort_enc_hdr *h;
+        struct vmsort_bm *cp;
+        u32 n, size[VMSORT_FMT_NR], f, w;
+        u8 *buf = NULL;
+        long ret = 0;
+
+        if (e->fmt >= VMSORT_FMT_NR && e->fmt != VMSORT_FMT_AUTO)
+                return -EINVAL;
+
+        /*
+         * Faults keep setting bits, so sizes computed on the live bitmap
+         * could be outgrown by the encoders.  Work from a private copy of
+         * the populated words instead.
+         */
+        cp = vmsort_copy_live(s);
+        if (!cp)
+                return -ENOMEM;
+
+        vmsort_enc_sizes(cp, &n, &size[VMSORT_FMT_VARINT],
+                         &size[VMSORT_FMT_RUNS]);
+        size[VMSORT_FMT_U16]    = n * sizeof(u16);
+        size[VMSORT_FMT_EF]     = vmsort_ef_size(n);
+        size[VMSORT_FMT_BITMAP] = 65536 / 8;
+
+        if (e->fmt == VMSORT_FMT_AUTO)
+                for (e->fmt = 0, f = 1; f < VMSORT_FMT_NR; ++f)
+                        if (size[f] < size[e->fmt])
+                                e->fmt = f;
+        e->keys  = n;
+        e->bytes = sizeof(*h) + size[e->fmt];
+        if (e->bytes > e->cap) {
+                ret = -ENOSPC;          /* e->bytes tells how much */
+                goto out;
+        }
+
+        buf = kvmalloc(e->bytes, GFP_KERNEL);
+        if (!buf) {
+                ret = -ENOMEM;
+                goto out;
+        }
+        h = (struct vmsort_enc_hdr *)buf;
+        *h = (struct vmsort_enc_hdr){ .fmt = e->fmt, .keys = n,
+                                      .param = vmsort_ef_lbits(n) };
+        switch (e->fmt) {
+        case VMSORT_FMT_U16: {
+                u32 pos = 0;
+                vmsort_bm_decode(cp, &pos, 65536, (u16 *)(h + 1), n);
+                break;
+        }
+        case VMSORT_FMT_VARINT: vmsort_enc_varint(cp, (u8 *)(h + 1));   break;
+        case VMSORT_FMT_EF:     vmsort_enc_ef(cp, n, (u8 *)(h + 1));    break;
+        case VMSORT_FMT_RUNS:   vmsort_enc_runs(cp, (u8 *)(h + 1));     break;
+        case VMSORT_FMT_BITMAP:
+                /* words outside cp->l1 were never copied */
+                memset(h + 1, 0, 65536 / 8);
+                for_each_set_bit(w, cp->l1, 1024)
+                        ((unsigned long *)(h + 1))[w] = cp->l0[w];
+                break;
+        }
+
+        if (copy_to_user((void __user *)(uintptr_t)e->ptr, buf, e->bytes))
+                ret = -EFAULT;
+        vmsort_count(s, VS_ENCODE, 1);
+        vmsort_count(s, VS_ENCODE_BYTES, e->bytes);
+out:
+        kvfree(buf);
+        kvfree(cp);
+        return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/* Session images                                                     */
+/*                                                                    */
+/* Restore is O(populated l1 blocks) for the key set, plus O(keys)    */
+/* with counts.  Pages are not mapped: the first touch of a restored  */
+/* key still faults once, but finds its bit already set.              */
+/* ------------------------------------------------------------------ */
+static u64 *vmsort_key_word(struct vmsort_session *s, u16 k, bool alloc)
+{
+        unsigned long v = READ_ONCE(s->chunk_pool[k / CHUNK_PAGES]);
+        int order;
+
+        if (!v && alloc)
+                v = vmsort_chunk_alloc(s, k / CHUNK_PAGES, &order);
+        if (!v)
+                return NULL;
+        return kmap_local_page(chunk_page(v) +
+                               (v & CHUNK_SMALL ? 0 : k & (CHUNK_PAGES - 1)));
+}
+
+/*
+ * Counts need one page per key.  An order‑0 chunk backs all of its
+ * keys with one page and the sink backs every key it took, so their
+ * words are shared; refuse rather than save or restore garbage.
+ * snap_sem held.
+ */
+static int vmsort_count_pages(struct vmsort_session *s,
+                              const unsigned long *l1, bool alloc)
+{
+        unsigned long v;
+        int order;
+        u32 w;
+
+        if (READ_ONCE(s->sunk))
+                return -EOPNOTSUPP;
+        for_each_set_bit(w, l1, 1024) {
+                v = READ_ONCE(s->chunk_pool[w * 64 / CHUNK_PAGES]);
+                if (!v && alloc)
+                        v = vmsort_chunk_alloc(s, w * 64 / CHUNK_PAGES, &order);
+                if (!v && alloc)
+                        return -ENOMEM;
+                if (v & CHUNK_SMALL)
+                        return -EOPNOTSUPP;
+        }
+        return 0;
+}
+
+static long vmsort_save(struct vmsort_session *s, struct vmsort_image *im)
+{
+        struct vmsort_image_hdr *h;
+        struct vmsort_bm *cp;
+        u64 *p, *word;
+        u32 w, keys = 0, blocks;
+        unsigned long bits;
+        u8 *buf = NULL;
+        long ret = 0;
+
+        if (im->flags & ~VMSORT_IMG_COUNTS)
+                return -EINVAL;
+        cp = vmsort_copy_live(s);
+        if (!cp)
+                return -ENOMEM;
+        blocks = bitmap_weight(cp->l1, 1024);
+        for_each_set_bit(w, cp->l1, 1024)
+                keys += hweight_long(cp->l0[w]);
+
+        im->keys  = keys;
+        im->bytes = sizeof(*h) + 1024 / 8 + blocks * sizeof(u64) +
+                    (im->flags & VMSORT_IMG_COUNTS ? keys * sizeof(u64) : 0);
+        if (im->bytes > im->cap) {
+                ret = -ENOSPC;
+                goto out;
+        }
+        buf = kvmalloc(im->bytes, GFP_KERNEL);
+        if (!buf) {
+                ret = -ENOMEM;
+                goto out;
+        }
+
+        h = (struct vmsort_image_hdr *)buf;
+        *h = (struct vmsort_image_hdr){ .magic = VMSORT_IMG_MAGIC,
+                                        .flags = im->flags,
+                                        .keys = keys, .blocks = blocks };
+        p = (u64 *)(h + 1);
+        memcpy(p, cp->l1, 1024 / 8);
+        p += 1024 / 64;
+        for_each_set_bit(w, cp->l1, 1024)
+                *p++ = cp->l0[w];
+        if (im->flags & VMSORT_IMG_COUNTS) {
+                down_read(&s->snap_sem);        /* keeps the shrinker off */
+                ret = vmsort_count_pages(s, cp->l1, false);
+                if (ret) {
+                        up_read(&s->snap_sem);
+                        goto out;
+                }
+                for_each_set_bit(w, cp->l1, 1024)
+                        for (bits = cp->l0[w]; bits; bits &= bits - 1) {
+                                word = vmsort_key_word(s, (w << 6) | __ffs(bits),
+                                                       false);
+                                *p++ = word ? READ_ONCE(*word) : 0;
+                                if (word)
+                                        kunmap_local(word);
+                        }
+                up_read(&s->snap_sem);
+        }
+
+        if (copy_to_user((void __user *)(uintptr_t)im->ptr, buf, im->bytes))
+                ret = -EFAULT;
+        vmsort_count(s, VS_SAVE, 1);
+out:
+        kvfree(buf);
+        kvfree(cp);
+        return ret;
+}
+
+static long vmsort_restore(struct vmsort_session *s, struct vmsort_image *im)
+{
+        const struct vmsort_image_hdr *h;
+        const unsigned long *l1;
+        struct vmsort_bm *live;
+        const u64 *l0, *cnt;
+        u32 w, i, keys = 0;
+        unsigned long bits;
+        u64 *word;
+        u8 *buf;
+        long ret = 0;
+
+        if (im->cap < sizeof(*h) + 1024 / 8 ||
+            im->cap > sizeof(*h) + (1024 / 8) + (1024 + 65536) * sizeof(u64))
+                return -EINVAL;
+        buf = kvmalloc(im->cap, GFP_KERNEL);
+        if (!buf)
+                return -ENOMEM;
+        if (copy_from_user(buf, (void __user *)(uintptr_t)im->ptr, im->cap)) {
+                ret = -EFAULT;
+                goto out;
+        }
+
+        /* validate everything before touching the session */
+        ret = -EINVAL;
+        h   = (const struct vmsort_image_hdr *)buf;
+        l1  = (const unsigned long *)(h + 1);
+        l0  = (const u64 *)(h + 1) + 1024 / 64;
+        if (h->magic != VMSORT_IMG_MAGIC || h->flags & ~VMSORT_IMG_COUNTS ||
+            h->blocks != bitmap_weight(l1, 1024) ||
+            im->cap != sizeof(*h) + 1024 / 8 + h->blocks * sizeof(u64) +
+                       (h->flags & VMSORT_IMG_COUNTS ? h->keys * sizeof(u64) : 0))
+                goto out;
+        for (i = 0; i < h->blocks; ++i) {
+                if (!l0[i])
+                        goto out;
+                keys += hweight64(l0[i]);
+        }
+        if (keys != h->keys)
+                goto out;
+
+        /* cheap early refusal; rechecked under snap_sem below */
+        if (READ_ONCE(s->snap_gen) || READ_ONCE(s->epoch) ||
+            !bitmap_empty(s->bm[READ_ONCE(s->live)].l1, 1024)) {
+                ret = -EBUSY;
+                goto out;
+        }
+
+        /* counters first: pages are private until the bits are visible */
+        cnt = l0 + h->blocks;
+        if (h->flags & VMSORT_IMG_COUNTS) {
+                i = 0;
+                down_read(&s->snap_sem);        /* keeps the shrinker off */
+                ret = vmsort_count_pages(s, l1, true);
+                if (ret) {
+                        up_read(&s->snap_sem);
+                        goto out;
+                }
+                for_each_set_bit(w, l1, 1024)
+                        for (bits = l0[i++]; bits; bits &= bits - 1, ++cnt) {
+                                word = vmsort_key_word(s, (w << 6) | __ffs(bits),
+                                                       true);
+                                if (!word) {
+                                        up_read(&s->snap_sem);
+                                        ret = -ENOMEM;
+                                        goto out;
+                                }
+                                WRITE_ONCE(*word, *cnt);
+                                kunmap_local(word);
+                        }
+                up_read(&s->snap_sem);
+        }
+
+        down_write(&s->snap_sem);
+        live = &s->bm[s->live];
+        if (s->snap_gen || s->epoch || !bitmap_empty(live->l1, 1024)) {
+                up_write(&s->snap_sem);
+                ret = -EBUSY;           /* only into a fresh mapping */
+                goto out;
+        }
+        i = 0;
+        for_each_set_bit(w, l1, 1024)
+                live->l0[w] = l0[i++];
+        bitmap_copy(live->l1, l1, 1024);
+        s->rd_cursor = 0;
+        up_write(&s->snap_sem);
+
+        im->keys  = keys;
+        im->bytes = im->cap;
+        ret = 0;
+        vmsort_count(s, VS_RESTORE, 1);
+out:
+        kvfree(buf);
+        return ret;
+}
+
+/* ------------------------------------------------------------------ */
+/* Priority queue                                                     */
+/*                                                                    */
+/* The bitmap finds the next present key; its page's first word says  */
+/* whether the bucket still holds anything.  snap_sem keeps the       */
+/* shrinker off the chunks while their pages are read.                */
+/* ------------------------------------------------------------------ */
+static long vmsort_pq_next(struct vmsort_session *s, struct vmsort_pq *q)
+{
+        u32 pos = q->from, fill, i, out = 0, skipped = 0;
+        u16 buf[64], keys[1024];
+        u64 *word;
+        long ret = 0;
+
+        if (q->cap > ARRAY_SIZE(keys))
+                return -EINVAL;
+        down_read(&s->snap_sem);
+        while (out < q->cap &&
+               (fill = vmsort_bm_decode(&s->bm[s->live], &pos, 65536, buf,
+                                        ARRAY_SIZE(buf)))) {
+                for (i = 0; i < fill && out < q->cap; ++i) {
+                        word = vmsort_key_word(s, buf[i], false);
+                        if (word && READ_ONCE(*word))
+                                keys[out++] = buf[i];
+                        else
+                                ++skipped;
+                        if (word)
+                                kunmap_local(word);
+                }
+        }
+        up_read(&s->snap_sem);
+
+        q->out = out;
+        q->skipped = skipped;
+        if (out && copy_to_user((u16 __user *)(uintptr_t)q->ptr, keys,
+                                out * sizeof(u16)))
+                ret = -EFAULT;
+        vmsort_count(s, VS_PQ_NEXT, 1);
+        vmsort_count(s, VS_PQ_SKIP, skipped);
+        return ret;
+}
+
+static long vmsort_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+{
+        struct vmsort_session *s = f->private_data;
+        void __user *uarg = (void __user *)arg;
+        const struct vmsort_bm *bm;
+        struct vmsort_bm *cp;
+        struct vmsort_iter it;
+        struct vmsort_range r;
+        struct vmsort_snap sn;
+        struct vmsort_setop so;
+        struct vmsort_enc en;
+        struct vmsort_pin pn;
+        struct vmsort_image im;
+        struct vmsort_budget bu;
+        struct vmsort_seg sg;
+        struct vmsort_pq pq;
+        long ret = 0;
+
+        switch (cmd) {
+        case VMSORT_IOCTL:
+                if (copy_from_user(&it, uarg, sizeof(it)))
+                        return -EFAULT;
+                ret = vmsort_extract(s, NULL, 0, 65536,
+                                     (u16 __user *)(uintptr_t)it.ptr,
+                                     it.cap, &it.out);
+                if (ret) return ret;
+                return copy_to_user(uarg, &it, sizeof(it)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_DELTA:
+                if (copy_from_user(&it, uarg, sizeof(it)))
+                        return -EFAULT;
+                ret = vmsort_delta(s, &it);
+                if (ret) return ret;
+                return copy_to_user(uarg, &it, sizeof(it)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_COUNT:
+        case VMSORT_IOC_RANGE:
+        case VMSORT_IOC_RANGE_DESC:
+                if (copy_from_user(&r, uarg, sizeof(r)))
+                        return -EFAULT;
+                if (r.lo >= r.hi || r.hi > 65536)
+                        return -EINVAL;
+                if (cmd == VMSORT_IOC_COUNT) {
+                        down_read(&s->snap_sem);
+                        r.out = vmsort_bm_count(&s->bm[s->live], r.lo, r.hi);
+                        up_read(&s->snap_sem);
+                } else {
+                        ret = vmsort_extract_dir(s, NULL, r.lo, r.hi,
+                                                 (u16 __user *)(uintptr_t)r.ptr,
+                                                 r.cap, &r.out,
+                                                 cmd == VMSORT_IOC_RANGE_DESC);
+                }
+                if (ret) return ret;
+                return copy_to_user(uarg, &r, sizeof(r)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_SNAPSHOT:
+        case VMSORT_IOC_SNAP_READ:
+                if (copy_from_user(&sn, uarg, sizeof(sn)))
+                        return -EFAULT;
+                if (READ_ONCE(s->epoch))
+                        return -EBUSY;
+                if (cmd == VMSORT_IOC_SNAPSHOT)
+                        vmsort_snapshot(s);
+                else
+                        down_read(&s->snap_sem);
+                bm      = &s->bm[!s->live];
+                sn.gen  = s->snap_gen;
+                sn.keys = bitmap_weight(bm->l0, 65536);
+                sn.out  = 0;
+                cp      = sn.ptr ? vmsort_copy_bm(bm) : NULL;
+                up_read(&s->snap_sem);
+                if (sn.ptr && !cp)
+                        return -ENOMEM;
+                if (cp)
+                        ret = vmsort_extract(s, cp, 0, 65536,
+                                             (u16 __user *)(uintptr_t)sn.ptr,
+                                             sn.cap, &sn.out);
+                kvfree(cp);
+                if (ret) return ret;
+                return copy_to_user(uarg, &sn, sizeof(sn)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_EPOCH_FLIP:
+                if (copy_from_user(&sn, uarg, sizeof(sn)))
+                        return -EFAULT;
+                ret = vmsort_epoch_flip(s, &sn);
+                if (ret) return ret;
+                return copy_to_user(uarg, &sn, sizeof(sn)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_SETOP:
+                if (copy_from_user(&so, uarg, sizeof(so)))
+                        return -EFAULT;
+                ret = vmsort_setop(s, &so);
+                if (ret) return ret;
+                return copy_to_user(uarg, &so, sizeof(so)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_PIN:
+                if (copy_from_user(&pn, uarg, sizeof(pn)))
+                        return -EFAULT;
+                ret = vmsort_pin(s, &pn);
+                if (ret) return ret;
+                return copy_to_user(uarg, &pn, sizeof(pn)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_PIN_READ:
+                if (copy_from_user(&r, uarg, sizeof(r)))
+                        return -EFAULT;
+                if (r.lo >= r.hi || r.hi > 65536)
+                        return -EINVAL;
+                down_read(&s->snap_sem);
+                ret = vmsort_pin_read(s, &s->bm[s->live], &r);
+                up_read(&s->snap_sem);
+                if (ret) return ret;
+                return put_user(r.out, &((struct vmsort_range __user *)uarg)->out);
+
+        case VMSORT_IOC_SAVE:
+        case VMSORT_IOC_RESTORE:
+                if (copy_from_user(&im, uarg, sizeof(im)))
+                        return -EFAULT;
+                if (cmd == VMSORT_IOC_SAVE)
+                        ret = vmsort_save(s, &im);
+                else
+                        ret = vmsort_restore(s, &im);
+                if (ret && ret != -ENOSPC) return ret;
+                if (copy_to_user(uarg, &im, sizeof(im)))
+                        return -EFAULT;
+                return ret;
+
+        case VMSORT_IOC_BUDGET:
+                if (copy_from_user(&bu, uarg, sizeof(bu)))
+                        return -EFAULT;
+                WRITE_ONCE(s->budget, bu.bytes >> PAGE_SHIFT);
+                bu.used = (u64)atomic_long_read(&s->pages) << PAGE_SHIFT;
+                return copy_to_user(uarg, &bu, sizeof(bu)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_PREPARE:
+                return vmsort_prepare(s);
+
+        case VMSORT_IOC_PQ_NEXT:
+                if (copy_from_user(&pq, uarg, sizeof(pq)))
+                        return -EFAULT;
+                if (pq.from > 65536)
+                        return -EINVAL;
+                ret = vmsort_pq_next(s, &pq);
+                if (ret) return ret;
+                return copy_to_user(uarg, &pq, sizeof(pq)) ? -EFAULT : 0;
+
+        case VMSORT_IOC_SEGMENTS:
+                if (copy_from_user(&sg, uarg, sizeof(sg)))
+                        return -EFAULT;
+                ret = vmsort_segments(s, &sg);
+                if (ret && ret != -ENOSPC) return ret;
+                if (copy_to_user(uarg, &sg, sizeof(sg)))
+                        return -EFAULT;
+                return ret;
+
+        case VMSORT_IOC_ENCODE:
+                if (copy_from_user(&en, uarg, sizeof(en)))
+                        return -EFAULT;
+                ret = vmsort_encode(s, &en);
+                if (ret && ret != -ENOSPC) return ret;
+                if (copy_to_user(uarg, &en, sizeof(en)))
+                        return -EFAULT;
+                return ret;
+        }
+        return -ENOTTY;
+}
+
+/* ------------------------------------------------------------------ */
+/* Statistics: /proc/<pid>/fdinfo/<fd> and debugfs vmsort/stats       */
+/* ------------------------------------------------------------------ */
+static void vmsort_show_fdinfo(struct seq_file *m, struct file *f)
+{
+        struct vmsort_session *s = f->private_data;
+        struct vmsort_stats *sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+        int i, chunks = 0;
+
+        if (!sum) return;
+        for (i = 0; i < CHUNKS; ++i)
+                chunks += !!s->chunk_pool[i];
+        seq_printf(m, "keys:\t%u\n",
+                   bitmap_weight(s->bm[READ_ONCE(s->live)].l0, 65536));
+        seq_printf(m, "dirty:\t%u\n", bitmap_weight(s->dirty.l0, 65536));
+        seq_printf(m, "snap_gen:\t%llu\n", s->snap_gen);
+        seq_printf(m, "epoch:\t%llu\n", s->epoch);
+        seq_printf(m, "chunks:\t%d\n", chunks);
+        seq_printf(m, "pinned_pages:\t%u\n", READ_ONCE(s->pin_nr));
+        seq_printf(m, "maps:\t%d\n", atomic_read(&s->maps));
+        seq_printf(m, "budget_pages:\t%lu\n", READ_ONCE(s->budget));
+        seq_printf(m, "chunk_pages:\t%ld\n", atomic_long_read(&s->pages));
+        vmsort_stats_fold(s->stats, sum);
+        vmsort_stats_show(m, sum);
+        kfree(sum);
+}
+
+static int stats_show(struct seq_file *m, void *unused)
+{
+        struct vmsort_stats *sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+
+        if (!sum) return -ENOMEM;
+        seq_printf(m, "null_fault:\t%d\n", READ_ONCE(null_fault));
+        vmsort_stats_fold(&gstats, sum);
+        vmsort_stats_show(m, sum);
+        kfree(sum);
+        return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+/* ------------------------------------------------------------------ */
+/* io_uring passthrough                                               */
+/*                                                                    */
+/* INSERT and COUNT complete inline; EXTRACT and RESET return -EAGAIN */
+/* on the nonblocking issue, so io_uring punts them to an io‑wq       */
+/* worker, which shares the submitter's mm for the user copies.       */
+/* ------------------------------------------------------------------ */
+/* set keys without faults, in the same SRCU section a fault would use */
+static int vmsort_insert(struct vmsort_session *s, u64 addr, u32 len)
+{
+        const u16 __user *src = (const u16 __user *)(uintptr_t)addr;
+        u32 i, n, added = 0, total = len;
+        u16 buf[1024];
+        int idx;
+
+        while (len) {
+                n = min(len, 1024U);
+                if (copy_from_user(buf, src, n * sizeof(u16)))
+                        return -EFAULT;
+                idx = srcu_read_lock(&s->srcu);
+                for (i = 0; i < n; ++i)
+                        if (vmsort_bm_set(&s->bm[READ_ONCE(s->live)], buf[i])) {
+                                vmsort_bm_set(&s->dirty, buf[i]);
+                                ++added;
+                        }
+                srcu_read_unlock(&s->srcu, idx);
+                src += n;
+                len -= n;
+        }
+        vmsort_count(s, VS_BM_NEW, added);
+        vmsort_count(s, VS_BM_DUP, total - added);
+        return added;
+}
+
+/*
+ * Empty both generations and leave snapshot/epoch mode.  Bits are
+ * cleared before the SRCU wait and the whole window is zapped after
+ * it, so a fault that raced the clear cannot keep a PTE for a key that
+ * is no longer in the set.
+ */
+static int vmsort_reset(struct vmsort_session *s)
+{
+        struct mm_struct *mm = current->mm;
+        struct vm_area_struct *vma;
+
+        mmap_read_lock(mm);
+        vma = vmsort_window(s, mm);
+        if (!vma && atomic_read(&s->maps)) {
+                mmap_read_unlock(mm);
+                return -ENXIO;
+        }
+        down_write(&s->snap_sem);
+        vmsort_bm_clear(&s->bm[0]);
+        vmsort_bm_clear(&s->bm[1]);
+        vmsort_bm_clear(&s->dirty);
+        synchronize_srcu_expedited(&s->srcu);
+        if (vma)
+                zap_vma_ptes(vma, vma->vm_start, WIN);
+        s->snap_gen  = 0;
+        s->rd_cursor = 0;
+        WRITE_ONCE(s->sunk, false);
+        WRITE_ONCE(s->epoch, 0);
+        up_write(&s->snap_sem);
+        mmap_read_unlock(mm);
+        return 0;
+}
+
+static int vmsort_uring_cmd(struct io_uring_cmd *ioucmd,
+                            unsigned int issue_flags)
+{
+        struct vmsort_session *s = ioucmd->file->private_data;
+        const struct vmsort_uring_cmd *c = io_uring_sqe_cmd(ioucmd->sqe);
+        bool nonblock = issue_flags & IO_URING_F_NONBLOCK;
+        u64 addr = READ_ONCE(c->addr);
+        u32 len  = READ_ONCE(c->len), out = 0;
+        long ret;
+
+        if (READ_ONCE(c->flags))
+                return -EINVAL;
+        vmsort_count(s, VS_URING, 1);
+
+        switch (ioucmd->cmd_op) {
+        case VMSORT_URING_INSERT:
+                return vmsort_insert(s, addr, len);
+
+        case VMSORT_URING_COUNT:
+                if (!nonblock)
+                        down_read(&s->snap_sem);
+                else if (!down_read_trylock(&s->snap_sem))
+                        goto punt;
+                out = vmsort_bm_count(&s->bm[s->live], 0, 65536);
+                up_read(&s->snap_sem);
+                return out;
+
+        case VMSORT_URING_EXTRACT:
+                if (nonblock)
+                        goto punt;
+                ret = vmsort_extract(s, NULL, 0, 65536,
+                                     (u16 __user *)(uintptr_t)addr, len, &out);
+                return ret ?: out;
+
+        case VMSORT_URING_RESET:
+                if (nonblock)
+                        goto punt;
+                return vmsort_reset(s);
+        }
+        return -EINVAL;
+punt:
+        vmsort_count(s, VS_URING_PUNT, 1);
+        return -EAGAIN;
 }
 
 static const struct file_operations fops = {
         .owner          = THIS_MODULE,
+        .open           = vmsort_open,
+        .release        = vmsort_release,
         .mmap           = vmsort_mmap,
+        .read_iter      = vmsort_read_iter,
+        .splice_read    = copy_splice_read,
+        .llseek         = default_llseek,
         .unlocked_ioctl = vmsort_ioctl,
+        .show_fdinfo    = vmsort_show_fdinfo,
+        .uring_cmd      = vmsort_uring_cmd,
 };
 
 /* ------------------------------------------------------------------ */
@@ -121,27 +1744,51 @@ static const struct file_operations fops = {
 /* ------------------------------------------------------------------ */
 static int __init vmsort_init(void)
 {
-        major = register_chrdev(0, DEV, &fops);
-        if (major < 0) return major;
+        sink_page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+        if (!sink_page) return -ENOMEM;
 
-        chunk_pool = kcalloc(CHUNKS, sizeof(struct page *), GFP_KERNEL);
-        if (!chunk_pool) {
-                unregister_chrdev(major, DEV); return -ENOMEM;
+        lru_cache = kmem_cache_create("vmsort_lru",
+                                      sizeof(struct vmsort_lru_node), 0,
+                                      SLAB_ACCOUNT, NULL);
+        vmsort_shrinker = shrinker_alloc(SHRINKER_MEMCG_AWARE |
+                                         SHRINKER_NUMA_AWARE, DEV);
+        if (!lru_cache || !vmsort_shrinker)
+                goto err;
+        if (list_lru_init_memcg(&vmsort_lru, vmsort_shrinker))
+                goto err;
+        vmsort_shrinker->count_objects = vmsort_shrink_count;
+        vmsort_shrinker->scan_objects  = vmsort_shrink_scan;
+        vmsort_shrinker->seeks         = DEFAULT_SEEKS;
+        shrinker_register(vmsort_shrinker);
+
+        major = register_chrdev(0, DEV, &fops);
+        if (major < 0) {
+                shrinker_free(vmsort_shrinker);
+                list_lru_destroy(&vmsort_lru);
+                kmem_cache_destroy(lru_cache);
+                __free_page(sink_page); return major;
         }
+
+        dbg_dir = debugfs_create_dir(DEV, NULL);
+        debugfs_create_file("stats", 0444, dbg_dir, NULL, &stats_fops);
+
         pr_info("vmsort: /dev/%s (major %d) ready\n", DEV, major);
         return 0;
+err:
+        shrinker_free(vmsort_shrinker);         /* NULL‑safe */
+        kmem_cache_destroy(lru_cache);
+        __free_page(sink_page);
+        return -ENOMEM;
 }
 
 static void __exit vmsort_exit(void)
 {
-        int i;
-        for (i = 0; i < CHUNKS; ++i)
-                if (chunk_pool[i])
-                        compound_order(chunk_pool[i]) == 9 ?
-                                __free_pages(chunk_pool[i], 9) :
-                                __free_page(chunk_pool[i]);
-        kfree(chunk_pool);
+        debugfs_remove_recursive(dbg_dir);
         unregister_chrdev(major, DEV);
+        shrinker_free(vmsort_shrinker);
+        list_lru_destroy(&vmsort_lru);
+        kmem_cache_destroy(lru_cache);
+        __free_page(sink_page);
         pr_info("vmsort: unloaded\n");
 }
 
@@ -150,4 +1797,3 @@ MODULE_AUTHOR("Optimised example");
 MODULE_DESCRIPTION("Virtual‑memory counting sort, batched & ffs‑scanned");
 module_init(vmsort_init);
 module_exit(vmsort_exit);
-
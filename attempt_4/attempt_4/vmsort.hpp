@@ -0,0 +1,250 @@
+// vmsort.hpp  —  header-only userspace port of struct vmsort_bm
+//
+// vmsort::bitset_sorter<KeyBits, Levels, Word> is the kernel's bitmap
+// hierarchy without the kernel: level 0 has one bit per key, and every
+// level above has one bit per non-empty word of the level below, up to
+// a top level scanned linearly (one word with the default depth).  All
+// geometry is constexpr, the per-level code is instantiated per level,
+// so set, clear and extraction unroll into straight-line code.
+#ifndef VMSORT_HPP_
+#define VMSORT_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace vmsort {
+
+namespace detail {
+
+constexpr unsigned log2c(std::size_t x) { return x <= 1 ? 0 : 1 + log2c(x / 2); }
+
+template <class Word>
+constexpr unsigned word_shift = log2c(sizeof(Word) * 8);
+
+// depth at which the top level fits in a single word
+template <class Word>
+constexpr unsigned auto_levels(unsigned key_bits)
+{
+    unsigned l = 1;
+    for (; key_bits > word_shift<Word>; key_bits -= word_shift<Word>) ++l;
+    return l;
+}
+
+template <unsigned Bits>
+using key_t = std::conditional_t<Bits <= 8, std::uint8_t,
+              std::conditional_t<Bits <= 16, std::uint16_t, std::uint32_t>>;
+
+template <class Word>
+inline unsigned ctz(Word x)
+{
+    if constexpr (sizeof(Word) <= sizeof(unsigned)) return __builtin_ctz(x);
+    else return __builtin_ctzll(x);
+}
+
+} // namespace detail
+
+// bump allocator for sorter storage: one block, no per-sorter malloc
+class arena {
+public:
+    explicit arena(std::size_t bytes)
+        : base_(static_cast<unsigned char *>(std::malloc(bytes))), cap_(base_ ? bytes : 0) {}
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+    ~arena() { std::free(base_); }
+
+    // nullptr when exhausted
+    void *allocate(std::size_t bytes, std::size_t align)
+    {
+        std::size_t at = (used_ + align - 1) & ~(align - 1);
+        if (at + bytes > cap_) return nullptr;
+        used_ = at + bytes;
+        return base_ + at;
+    }
+    void reset() { used_ = 0; }                 // sorters using it must be gone
+    std::size_t used() const { return used_; }
+
+private:
+    unsigned char *base_;
+    std::size_t cap_, used_ = 0;
+};
+
+template <unsigned KeyBits, unsigned Levels = detail::auto_levels<std::uint64_t>(KeyBits),
+          class Word = std::uint64_t>
+class bitset_sorter {
+    static_assert(KeyBits >= 1 && KeyBits <= 32, "1..32-bit keys");
+    static_assert(std::is_unsigned_v<Word>, "Word must be an unsigned integer");
+    static_assert(Levels >= 1 && Levels <= detail::auto_levels<Word>(KeyBits),
+                  "deeper than one top word");
+
+public:
+    using key_type  = detail::key_t<KeyBits>;
+    using word_type = Word;
+
+    static constexpr unsigned    fanout = sizeof(Word) * 8;   // bits per summary word
+    static constexpr unsigned    shift  = detail::word_shift<Word>;
+    static constexpr std::size_t keys   = std::size_t(1) << KeyBits;
+
+    // words of level l, and where level l starts in the block
+    static constexpr std::size_t words(unsigned l)
+    {
+        std::size_t n = keys;
+        for (unsigned i = 0; i <= l; ++i) n = (n + fanout - 1) / fanout;
+        return n;
+    }
+    static constexpr std::size_t offset(unsigned l)
+    {
+        std::size_t o = 0;
+        for (unsigned i = 0; i < l; ++i) o += words(i);
+        return o;
+    }
+    static constexpr std::size_t total_words = offset(Levels);
+    static constexpr std::size_t bytes       = total_words * sizeof(Word);
+
+    // zeroed storage of its own (calloc: untouched pages stay lazy)
+    bitset_sorter()
+        : w_(static_cast<Word *>(std::calloc(total_words, sizeof(Word)))), own_(true)
+    {
+        if (!w_) throw std::bad_alloc();
+    }
+
+    // storage carved from @a, which must outlive the sorter
+    explicit bitset_sorter(arena &a)
+        : w_(static_cast<Word *>(a.allocate(bytes, 64))), own_(false)
+    {
+        if (!w_) throw std::bad_alloc();
+        std::memset(w_, 0, bytes);
+    }
+
+    bitset_sorter(const bitset_sorter &) = delete;
+    bitset_sorter &operator=(const bitset_sorter &) = delete;
+
+    bitset_sorter(bitset_sorter &&o) noexcept
+        : w_(std::exchange(o.w_, nullptr)), n_(std::exchange(o.n_, 0)),
+          own_(o.own_) {}
+
+    bitset_sorter &operator=(bitset_sorter &&o) noexcept
+    {
+        if (this != &o) {
+            release();
+            w_   = std::exchange(o.w_, nullptr);
+            n_   = std::exchange(o.n_, 0);
+            own_ = o.own_;
+        }
+        return *this;
+    }
+
+    ~bitset_sorter() { release(); }
+
+    // Keys must be below `keys`.  key_type rounds KeyBits up to 8, 16 or
+    // 32 bits, so other widths can be handed a larger k; that is a
+    // precondition violation, caught by assert in debug builds, not masked.
+
+    // true if @k was new; summaries are only touched when a word was empty
+    bool insert(key_type k) noexcept
+    {
+        assert(std::size_t(k) < keys);
+        Word &x = w_[std::size_t(k) >> shift];
+        Word  m = Word(1) << (k & (fanout - 1));
+        if (x & m) return false;
+        bool first = !x;
+        x |= m;
+        if constexpr (Levels > 1)
+            if (first) mark<1>(std::size_t(k) >> shift);
+        ++n_;
+        return true;
+    }
+
+    bool contains(key_type k) const noexcept
+    {
+        assert(std::size_t(k) < keys);
+        return w_[std::size_t(k) >> shift] >> (k & (fanout - 1)) & 1;
+    }
+
+    std::size_t size() const noexcept { return n_; }
+    bool empty() const noexcept { return !n_; }
+
+    // zero only populated words, found through the summaries
+    void clear() noexcept
+    {
+        for (std::size_t j = 0; j < words(Levels - 1); ++j)
+            if (w_[offset(Levels - 1) + j]) wipe<Levels - 1>(j);
+        n_ = 0;
+    }
+
+    // all keys ascending as base + key, widened to Out; out needs size()
+    template <class Out>
+    Out *extract(Out *out, Out base = Out()) const noexcept
+    {
+        for (std::size_t j = 0; j < words(Levels - 1); ++j)
+            out = emit<Levels - 1>(j, out, base);
+        return out;
+    }
+
+    // the same, through f(key) in ascending order
+    template <class F>
+    void for_each(F &&f) const
+    {
+        for (std::size_t j = 0; j < words(Levels - 1); ++j) visit<Levels - 1>(j, f);
+    }
+
+private:
+    template <unsigned L>
+    void mark(std::size_t i) noexcept
+    {
+        Word &x = w_[offset(L) + (i >> shift)];
+        bool first = !x;
+        x |= Word(1) << (i & (fanout - 1));
+        if constexpr (L + 1 < Levels)
+            if (first) mark<L + 1>(i >> shift);
+    }
+
+    template <unsigned L>
+    void wipe(std::size_t j) noexcept
+    {
+        if constexpr (L > 0)
+            for (Word x = w_[offset(L) + j]; x; x &= x - 1)
+                wipe<L - 1>(j * fanout + detail::ctz(x));
+        w_[offset(L) + j] = 0;
+    }
+
+    template <unsigned L, class Out>
+    Out *emit(std::size_t j, Out *out, Out base) const noexcept
+    {
+        for (Word x = w_[offset(L) + j]; x; x &= x - 1) {
+            std::size_t c = j * fanout + detail::ctz(x);
+            if constexpr (L == 0) *out++ = Out(base + Out(c));
+            else out = emit<L - 1>(c, out, base);
+        }
+        return out;
+    }
+
+    template <unsigned L, class F>
+    void visit(std::size_t j, F &f) const
+    {
+        for (Word x = w_[offset(L) + j]; x; x &= x - 1) {
+            std::size_t c = j * fanout + detail::ctz(x);
+            if constexpr (L == 0) f(key_type(c));
+            else visit<L - 1>(c, f);
+        }
+    }
+
+    void release() noexcept
+    {
+        if (own_) std::free(w_);
+        w_ = nullptr;
+    }
+
+    Word       *w_;
+    std::size_t n_ = 0;
+    bool        own_;
+};
+
+} // namespace vmsort
+
+#endif // VMSORT_HPP_
@@ -1,39 +1,38 @@
 #ifndef VMSORT_BM_H_
 #define VMSORT_BM_H_
 
+#include <linux/atomic.h>
 #include <linux/bitmap.h>
 #include <linux/types.h>
 
-static unsigned long vmsort_l1_global[16];
-
 struct vmsort_bm {
         DECLARE_BITMAP(l0, 65536);
-        u64  l1;
+        DECLARE_BITMAP(l1, 1024);       /* one bit per non‑empty l0 word */
         u16  iter_w, iter_b;
 };
 
 static inline void vmsort_bm_init(struct vmsort_bm *bm)
 {
         bitmap_zero(bm->l0, 65536);
-        bitmap_zero(vmsort_l1_global, 1024);
-        bm->l1      = (u64)(uintptr_t)vmsort_l1_global;
+        bitmap_zero(bm->l1, 1024);
         bm->iter_w  = 0;
         bm->iter_b  = 0;
 }
 
-static inline void vmsort_bm_set(struct vmsort_bm *bm, u16 k)
+/* returns true if @k was newly set, false on a duplicate */
+static inline bool vmsort_bm_set(struct vmsort_bm *bm, u16 k)
 {
-        if (k >= 65536) return;
         u16 w = k >> 6, b = k & 63;
-        if (!test_and_set_bit(b, bm->l0 + w))
-                set_bit(w, (unsigned long *)(uintptr_t)bm->l1);
+        if (test_and_set_bit(b, bm->l0 + w))
+                return false;
+        set_bit(w, bm->l1);
+        return true;
 }
 
 static inline bool vmsort_bm_next(struct vmsort_bm *bm, u16 *out)
 {
         for (; bm->iter_w < 1024; ++bm->iter_w) {
-                if (!test_bit(bm->iter_w,
-                              (unsigned long *)(uintptr_t)bm->l1))
+                if (!test_bit(bm->iter_w, bm->l1))
                         continue;
                 while (bm->iter_b < 64) {
                         if (test_bit(bm->iter_b, bm->l0 + bm->iter_w)) {
@@ -52,5 +51,191 @@ static inline void vmsort_bm_reset_iter(struct vmsort_bm *bm)
         bm->iter_w = bm->iter_b = 0;
 }
 
-#endif /* VMSORT_BM_H_ */
+/* bits of l0 word @w that fall inside keys [lo, hi) */
+static inline unsigned long vmsort_bm_word(const struct vmsort_bm *bm,
+                                           u32 w, u32 lo, u32 hi)
+{
+        unsigned long bits = bm->l0[w];
+
+        if (lo > (w << 6))
+                bits &= ~0UL << (lo & 63);
+        if (hi < ((w + 1) << 6))
+                bits &= (1UL << (hi & 63)) - 1;
+        return bits;
+}
+
+/* number of keys in [lo, hi); empty 64‑key blocks skipped via l1 */
+static inline u32 vmsort_bm_count(const struct vmsort_bm *bm, u32 lo, u32 hi)
+{
+        u32 w, n = 0;
+
+        if (lo >= hi)
+                return 0;
+        w = lo >> 6;
+        for_each_set_bit_from(w, bm->l1, (hi + 63) >> 6)
+                n += hweight_long(vmsort_bm_word(bm, w, lo, hi));
+        return n;
+}
+
+/*
+ * Cursor‑based decode, no shared iterator state: writes up to @cap keys
+ * from [*pos, hi) to @out in ascending order, advances *pos past the last
+ * key written and returns the count.  Safe to run concurrently on
+ * disjoint (or overlapping) ranges.
+ */
+static inline u32 vmsort_bm_decode(const struct vmsort_bm *bm, u32 *pos,
+                                   u32 hi, u16 *out, u32 cap)
+{
+        u32 w, n = 0, lo = *pos;
+
+        if (lo >= hi || !cap)
+                return 0;
+        w = lo >> 6;
+        for_each_set_bit_from(w, bm->l1, (hi + 63) >> 6) {
+                unsigned long bits = vmsort_bm_word(bm, w, lo, hi);
+
+                while (bits) {
+                        if (n == cap) {
+                                *pos = (w << 6) | __ffs(bits);
+                                return n;
+                        }
+                        out[n++] = (w << 6) | __ffs(bits);
+                        bits &= bits - 1;
+                }
+        }
+        *pos = hi;
+        return n;
+}
+
+/* highest l1 bit below @w (i.e. last non‑empty l0 word < w), or -1 */
+static inline int vmsort_bm_prev_word(const struct vmsort_bm *bm, u32 w)
+{
+        unsigned long m;
+        u32 i;
+
+        while (w) {
+                i = (w - 1) >> 6;
+                m = bm->l1[i];
+                if (w & 63)
+                        m &= (1UL << (w & 63)) - 1;
+                if (m)
+                        return (i << 6) | __fls(m);
+                w = i << 6;
+        }
+        return -1;
+}
+
+/*
+ * vmsort_bm_decode downwards: up to @cap keys from [lo, *pos) in
+ * descending order (__fls over l1, then l0), *pos left just above the
+ * next key to emit (lo when done).  Touches only the words it emits
+ * from plus one l1 word per 4096 empty keys skipped.
+ */
+static inline u32 vmsort_bm_decode_rev(const struct vmsort_bm *bm, u32 *pos,
+                                       u32 lo, u16 *out, u32 cap)
+{
+        u32 n = 0, hi = *pos, k;
+        unsigned long bits;
+        int w;
+
+        if (lo >= hi || !cap)
+                return 0;
+        for (w = vmsort_bm_prev_word(bm, (hi + 63) >> 6);
+             w >= (int)(lo >> 6); w = vmsort_bm_prev_word(bm, w)) {
+                bits = vmsort_bm_word(bm, w, lo, hi);
+                while (bits) {
+                        k = (w << 6) | __fls(bits);
+                        if (n == cap) {
+                                *pos = k + 1;
+                                return n;
+                        }
+                        out[n++] = k;
+                        bits &= ~(1UL << (k & 63));
+                }
+        }
+        *pos = lo;
+        return n;
+}
+
+/* position of the key with 0‑based rank @rank, 65536 if there is none */
+static inline u32 vmsort_bm_select(const struct vmsort_bm *bm, u32 rank)
+{
+        unsigned long bits;
+        u32 w, c;
+
+        for_each_set_bit(w, bm->l1, 1024) {
+                bits = bm->l0[w];
+                c = hweight_long(bits);
+                if (rank < c) {
+                        while (rank--)
+                                bits &= bits - 1;
+                        return (w << 6) | __ffs(bits);
+                }
+                rank -= c;
+        }
+        return 65536;
+}
+
+/* dst |= src; word‑atomic, so faults may keep setting bits in @dst */
+static inline void vmsort_bm_or(struct vmsort_bm *dst,
+                                const struct vmsort_bm *src)
+{
+        u32 w;
+
+        for_each_set_bit(w, src->l1, 1024) {
+                atomic_long_or(src->l0[w], (atomic_long_t *)&dst->l0[w]);
+                set_bit(w, dst->l1);
+        }
+}
 
+/* zero only the populated l0 words, found via l1 */
+static inline void vmsort_bm_clear(struct vmsort_bm *bm)
+{
+        u32 w;
+
+        for_each_set_bit(w, bm->l1, 1024)
+                bm->l0[w] = 0;
+        bitmap_zero(bm->l1, 1024);
+}
+
+/* word‑parallel set algebra; values match VMSORT_SET_* in vmsort_uapi.h */
+enum vmsort_bm_op { VMSORT_BM_AND, VMSORT_BM_OR, VMSORT_BM_ANDNOT,
+                    VMSORT_BM_XOR };
+
+/*
+ * r = r <op> b, touching only words that can change: r's l1 for AND and
+ * ANDNOT, b's l1 for OR and XOR.  @b may be live (bits still being set).
+ */
+static inline void vmsort_bm_combine(struct vmsort_bm *r,
+                                     const struct vmsort_bm *b,
+                                     enum vmsort_bm_op op)
+{
+        unsigned long word;
+        u32 w;
+
+        switch (op) {
+        case VMSORT_BM_AND:
+        case VMSORT_BM_ANDNOT:
+                for_each_set_bit(w, r->l1, 1024) {
+                        word = test_bit(w, b->l1) ? READ_ONCE(b->l0[w]) : 0;
+                        r->l0[w] &= op == VMSORT_BM_AND ? word : ~word;
+                        if (!r->l0[w])
+                                __clear_bit(w, r->l1);
+                }
+                break;
+        case VMSORT_BM_OR:
+        case VMSORT_BM_XOR:
+                for_each_set_bit(w, b->l1, 1024) {
+                        word = READ_ONCE(b->l0[w]);
+                        r->l0[w] = op == VMSORT_BM_OR ? r->l0[w] | word
+                                                      : r->l0[w] ^ word;
+                        if (r->l0[w])
+                                __set_bit(w, r->l1);
+                        else
+                                __clear_bit(w, r->l1);
+                }
+                break;
+        }
+}
+
+#endif /* VMSORT_BM_H_ */
@@ -0,0 +1,124 @@
+#ifndef VMSORT_ENC_H_
+#define VMSORT_ENC_H_
+
+/*
+ * Compressed extraction formats (see vmsort_uapi.h for the layouts).
+ * Sizes are exact and computed from the bitmap alone, so AUTO can pick
+ * the smallest format before anything is encoded.  Output is host byte
+ * order, i.e. little‑endian on every arch vmsort is built for.
+ */
+#include <linux/bitmap.h>
+#include <linux/log2.h>
+#include <linux/string.h>
+#include <linux/types.h>
+#include "vmsort_bm.h"
+
+static inline u32 vmsort_varint_len(u32 gap)
+{
+        return gap < (1U << 7) ? 1 : gap < (1U << 14) ? 2 : 3;
+}
+
+/* EF low‑bit width for n keys over the 16‑bit universe */
+static inline u32 vmsort_ef_lbits(u32 n)
+{
+        return n && n < 65536 ? ilog2(65536 / n) : 0;
+}
+
+static inline u32 vmsort_ef_size(u32 n)
+{
+        u32 l = vmsort_ef_lbits(n);
+
+        return 8 * (DIV_ROUND_UP(n * l, 64) +
+                    DIV_ROUND_UP(n + (65536 >> l), 64));
+}
+
+/* payload sizes (without header) for every format, in one l1 walk */
+static inline void vmsort_enc_sizes(const struct vmsort_bm *bm,
+                                    u32 *n, u32 *varint, u32 *runs)
+{
+        unsigned long bits, prev_msb = 0;
+        u32 w, last_w = ~0U;
+        int prev = -1;
+
+        *n = *varint = *runs = 0;
+        for_each_set_bit(w, bm->l1, 1024) {
+                bits = bm->l0[w];
+                if (w != last_w + 1)
+                        prev_msb = 0;
+                *n    += hweight_long(bits);
+                *runs += hweight_long(bits & ~((bits << 1) | prev_msb));
+                prev_msb = bits >> 63;
+                last_w   = w;
+                for (; bits; bits &= bits - 1) {
+                        int k = (w << 6) | __ffs(bits);
+                        *varint += vmsort_varint_len(k - prev - 1);
+                        prev = k;
+                }
+        }
+        *runs *= 4;
+}
+
+/* encoders write exactly the size computed above into @p */
+static inline void vmsort_enc_varint(const struct vmsort_bm *bm, u8 *p)
+{
+        unsigned long bits;
+        int prev = -1;
+        u32 w, gap;
+
+        for_each_set_bit(w, bm->l1, 1024)
+                for (bits = bm->l0[w]; bits; bits &= bits - 1) {
+                        int k = (w << 6) | __ffs(bits);
+                        for (gap = k - prev - 1; gap >= 0x80; gap >>= 7)
+                                *p++ = gap | 0x80;
+                        *p++ = gap;
+                        prev = k;
+                }
+}
+
+static inline void vmsort_enc_ef(const struct vmsort_bm *bm, u32 n, u8 *p)
+{
+        u32 l = vmsort_ef_lbits(n), i = 0, w;
+        u64 *low  = (u64 *)p;
+        u64 *high = low + DIV_ROUND_UP(n * l, 64);
+        unsigned long bits;
+
+        memset(p, 0, vmsort_ef_size(n));
+        for_each_set_bit(w, bm->l1, 1024)
+                for (bits = bm->l0[w]; bits; bits &= bits - 1, ++i) {
+                        u32 k = (w << 6) | __ffs(bits);
+                        u64 lo = k & ((1U << l) - 1), pos = (u64)i * l;
+
+                        if (l) {
+                                low[pos / 64] |= lo << (pos % 64);
+                                if (pos % 64 + l > 64)
+                                        low[pos / 64 + 1] |= lo >> (64 - pos % 64);
+                        }
+                        pos = (k >> l) + i;
+                        high[pos / 64] |= 1ULL << (pos % 64);
+                }
+}
+
+static inline void vmsort_enc_runs(const struct vmsort_bm *bm, u8 *p)
+{
+        u16 *r = (u16 *)p;
+        unsigned long bits;
+        int start = -1, prev = -2;
+        u32 w;
+
+        for_each_set_bit(w, bm->l1, 1024)
+                for (bits = bm->l0[w]; bits; bits &= bits - 1) {
+                        int k = (w << 6) | __ffs(bits);
+                        if (k != prev + 1) {
+                                if (start >= 0) {
+                                        *r++ = start; *r++ = prev - start;
+                                }
+                                start = k;
+                        }
+                        prev = k;
+                }
+        if (start >= 0) {
+                *r++ = start; *r++ = prev - start;
+        }
+}
+
+#endif /* VMSORT_ENC_H_ */
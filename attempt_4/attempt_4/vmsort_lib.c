@@ -0,0 +1,743 @@
+/* vmsort_lib.c  —  userspace helpers for /dev/vmsort sessions */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "vmsort_lib.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int vms_open(struct vms *s)
+{
+    s->fd = open("/dev/vmsort", O_RDWR | O_CLOEXEC);
+    if (s->fd < 0) return -errno;
+    void *p = mmap(NULL, VMS_WIN, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    if (p == MAP_FAILED) {
+        int e = errno; close(s->fd); s->fd = -1; return -e;
+    }
+    s->base = p;
+    return 0;
+}
+
+void vms_close(struct vms *s)
+{
+    if (s->base) munmap((void *)s->base, VMS_WIN);
+    if (s->fd >= 0) close(s->fd);
+    s->base = NULL; s->fd = -1;
+}
+
+long vms_extract(struct vms *s, uint16_t *out, uint32_t cap)
+{
+    struct vmsort_iter it = { .ptr = (uint64_t)(uintptr_t)out, .cap = cap };
+    if (ioctl(s->fd, VMSORT_IOCTL, &it)) return -errno;
+    return it.out;
+}
+
+long vms_extract_range(struct vms *s, uint32_t lo, uint32_t hi,
+                       uint16_t *out, uint32_t cap, int desc)
+{
+    struct vmsort_range r = { .ptr = (uint64_t)(uintptr_t)out, .lo = lo, .hi = hi,
+                              .cap = cap };
+    if (ioctl(s->fd, desc ? VMSORT_IOC_RANGE_DESC : VMSORT_IOC_RANGE, &r)) return -errno;
+    return r.out;
+}
+
+long vms_extract_delta(struct vms *s, uint16_t *out, uint32_t cap)
+{
+    struct vmsort_iter it = { .ptr = (uint64_t)(uintptr_t)out, .cap = cap };
+    if (ioctl(s->fd, VMSORT_IOC_DELTA, &it)) return -errno;
+    return it.out;
+}
+
+long vms_segments(struct vms *s, unsigned shift, uint16_t *out, uint32_t cap,
+                  uint32_t *offs, uint32_t flags)
+{
+    struct vmsort_seg sg = { .ptr = (uint64_t)(uintptr_t)out,
+                             .offs = (uint64_t)(uintptr_t)offs,
+                             .shift = shift, .cap = cap, .flags = flags };
+    if (ioctl(s->fd, VMSORT_IOC_SEGMENTS, &sg)) return -errno;
+    return sg.out;
+}
+
+uint64_t vms_stat(struct vms *s, const char *key)
+{
+    char path[64], line[512]; size_t kl = strlen(key); uint64_t v = 0;
+    snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", s->fd);
+    FILE *f = fopen(path, "r"); if (!f) return 0;
+    while (fgets(line, sizeof(line), f))
+        if (!strncmp(line, key, kl) && line[kl] == ':') {
+            v = strtoull(line + kl + 1, NULL, 10); break;
+        }
+    fclose(f);
+    return v;
+}
+
+int vms_pin(struct vms *s, uint16_t *out, uint32_t cap)
+{
+    struct vmsort_pin p = { .ptr = (uint64_t)(uintptr_t)out, .cap = cap };
+    return ioctl(s->fd, VMSORT_IOC_PIN, &p) ? -errno : 0;
+}
+
+long vms_extract_pinned(struct vms *s, uint32_t lo, uint32_t hi,
+                        uint32_t off, uint32_t cap)
+{
+    struct vmsort_range r = { .ptr = off, .lo = lo, .hi = hi, .cap = cap };
+    if (ioctl(s->fd, VMSORT_IOC_PIN_READ, &r)) return -errno;
+    return r.out;
+}
+
+int vms_prepare(struct vms *s)
+{
+    return ioctl(s->fd, VMSORT_IOC_PREPARE) ? -errno : 0;
+}
+
+long long vms_budget(struct vms *s, uint64_t bytes)
+{
+    struct vmsort_budget b = { .bytes = bytes };
+    if (ioctl(s->fd, VMSORT_IOC_BUDGET, &b)) return -errno;
+    return b.used;
+}
+
+long vms_extract_enc(struct vms *s, void *buf, uint32_t cap, uint32_t fmt,
+                     uint32_t *need)
+{
+    struct vmsort_enc e = { .ptr = (uint64_t)(uintptr_t)buf, .cap = cap, .fmt = fmt };
+    int r = ioctl(s->fd, VMSORT_IOC_ENCODE, &e);
+    if (need) *need = e.bytes;
+    if (r) return -errno;
+    return e.bytes;
+}
+
+long vms_save(struct vms *s, void *buf, uint32_t cap, uint32_t flags,
+              uint32_t *need)
+{
+    struct vmsort_image im = { .ptr = (uint64_t)(uintptr_t)buf, .cap = cap,
+                               .flags = flags };
+    int r = ioctl(s->fd, VMSORT_IOC_SAVE, &im);
+    if (need) *need = im.bytes;
+    if (r) return -errno;
+    return im.bytes;
+}
+
+long vms_restore(struct vms *s, const void *buf, uint32_t len)
+{
+    struct vmsort_image im = { .ptr = (uint64_t)(uintptr_t)buf, .cap = len };
+    if (ioctl(s->fd, VMSORT_IOC_RESTORE, &im)) return -errno;
+    return im.keys;
+}
+
+int vms_save_file(struct vms *s, const char *path, uint32_t flags)
+{
+    uint32_t need = 4096;
+    void *buf = NULL;
+    long n;
+    do {                                /* keys may grow between calls */
+        void *nb = realloc(buf, need);
+        if (!nb) { free(buf); return -ENOMEM; }
+        buf = nb;
+        n = vms_save(s, buf, need, flags, &need);
+    } while (n == -ENOSPC);
+    if (n >= 0) {
+        FILE *f = fopen(path, "wb");
+        if (!f) n = -errno;
+        else {
+            if (fwrite(buf, 1, n, f) != (size_t)n) n = -EIO;
+            if (fclose(f) && n >= 0) n = -errno;
+        }
+    }
+    free(buf);
+    return n < 0 ? (int)n : 0;
+}
+
+long vms_restore_file(struct vms *s, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -errno;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    rewind(f);
+    void *buf = len > 0 ? malloc(len) : NULL;
+    long n = buf && fread(buf, 1, len, f) == (size_t)len ? vms_restore(s, buf, len)
+                                                        : -EIO;
+    free(buf);
+    fclose(f);
+    return n;
+}
+
+/* ------------ priority queue ------------------------------------- */
+int vms_pq_open(struct vms_pq *q)
+{
+    q->ic = q->nc = q->hz = 0;
+    q->spill = NULL;
+    return vms_open(&q->s);
+}
+
+void vms_pq_close(struct vms_pq *q)
+{
+    if (q->spill)
+        for (size_t k = 0; k < VMS_KEYS; ++k) free(q->spill[k]);
+    free(q->spill);
+    q->spill = NULL;
+    vms_close(&q->s);
+}
+
+/* the page is prio's own: claimed by its tag, not by another key's */
+static int pq_own(struct vms_bucket *b, uint16_t prio, int claim)
+{
+    if (b->tag == prio + 1u) return 1;
+    if (b->tag || !claim) return 0;
+    b->tag = prio + 1u;
+    return 1;
+}
+
+/* slot i of the bucket: in its page, or spilled past VMS_PQ_ITEMS */
+static uint32_t *pq_slot(struct vms_pq *q, uint16_t prio, uint64_t i)
+{
+    return i < VMS_PQ_ITEMS ? &vms_pq_bucket(q, prio)->item[i]
+                            : &q->spill[prio][i - VMS_PQ_ITEMS];
+}
+
+int vms_pq_push(struct vms_pq *q, uint16_t prio, uint32_t item)
+{
+    struct vms_bucket *b = vms_pq_bucket(q, prio);
+    uint32_t lo = q->ic, hi = q->nc, m;
+    uint64_t x;
+
+    if (!pq_own(b, prio, 1)) return -ENOMEM;  /* degraded: shared page */
+    x = b->n - VMS_PQ_ITEMS;
+    /* the spill array doubles whenever it is full (64, 128, ...) */
+    if (b->n >= VMS_PQ_ITEMS && (!x || (x >= 64 && !(x & (x - 1))))) {
+        if (!q->spill && !(q->spill = calloc(VMS_KEYS, sizeof(*q->spill))))
+            return -ENOMEM;
+        uint32_t *p = realloc(q->spill[prio], (x ? 2 * x : 64) * sizeof(uint32_t));
+        if (!p) return -ENOMEM;
+        q->spill[prio] = p;
+    }
+    *pq_slot(q, prio, b->n) = item;
+    if (b->n++ || prio >= q->hz) return 0;
+
+    /* newly non‑empty below hz: keep cand[ic..nc) complete */
+    while (lo < hi) {
+        m = (lo + hi) / 2;
+        if (q->cand[m] < prio) lo = m + 1; else hi = m;
+    }
+    if (lo < q->nc && q->cand[lo] == prio) return 0;
+    if (lo == q->ic && q->ic) {
+        q->cand[--q->ic] = prio;
+    } else {
+        q->nc = lo;                     /* refetch from prio on */
+        q->hz = prio;
+    }
+    return 0;
+}
+
+/* first non‑empty candidate, refilling from the kernel as needed */
+static int pq_min(struct vms_pq *q)
+{
+    for (;;) {
+        for (; q->ic < q->nc; ++q->ic) {
+            uint16_t k = q->cand[q->ic];
+            if (pq_own(vms_pq_bucket(q, k), k, 0) && vms_pq_bucket(q, k)->n) return k;
+        }
+        if (q->hz >= VMS_KEYS) return -ENOENT;
+        struct vmsort_pq p = { .ptr = (uint64_t)(uintptr_t)q->cand,
+                               .from = q->hz, .cap = VMS_PQ_BATCH };
+        if (ioctl(q->s.fd, VMSORT_IOC_PQ_NEXT, &p)) return -errno;
+        q->ic = 0;
+        q->nc = p.out;
+        q->hz = p.out == VMS_PQ_BATCH ? q->cand[p.out - 1] + 1u : VMS_KEYS;
+    }
+}
+
+int vms_pq_peek(struct vms_pq *q, uint16_t *prio, uint32_t *item)
+{
+    int k = pq_min(q);
+    if (k < 0) return k;
+    *prio = k;
+    *item = *pq_slot(q, k, vms_pq_bucket(q, k)->n - 1);
+    return 0;
+}
+
+int vms_pq_pop(struct vms_pq *q, uint16_t *prio, uint32_t *item)
+{
+    int k = pq_min(q);
+    if (k < 0) return k;
+    *prio = k;
+    *item = *pq_slot(q, k, --vms_pq_bucket(q, k)->n);
+    return 0;
+}
+
+int vms_pq_decrease(struct vms_pq *q, uint32_t item, uint16_t old, uint16_t prio)
+{
+    struct vms_bucket *b = vms_pq_bucket(q, old);
+    if (!pq_own(b, old, 0)) return -ENOENT;
+    for (uint64_t i = 0; i < b->n; ++i)
+        if (*pq_slot(q, old, i) == item) {
+            int r = vms_pq_push(q, prio, item);
+            if (r) return r;
+            *pq_slot(q, old, i) = *pq_slot(q, old, b->n - 1);
+            --b->n;
+            return 0;
+        }
+    return -ENOENT;
+}
+
+/* ------------ MSD pipeline --------------------------------------- */
+#define MSD_SMALL  32                   /* insertion sort at or below     */
+#define MSD_PAR    (1UL << 16)          /* fewer keys: one thread         */
+
+/* per‑worker leaf state: bitmap backend (l0/l1) or session (s.fd >= 0),
+   cnt[] holds each low key's multiplicity, valid for keys present    */
+struct msd_w {
+    struct vms s;
+    uint64_t   l0[1024], l1[16];
+    uint32_t   cnt[VMS_KEYS];
+    uint32_t   tag[VMS_KEYS], gen;      /* session: first sight per leaf  */
+    uint16_t   lows[VMS_KEYS];
+    uint32_t   offs[2];
+};
+
+struct msd_job {
+    void    *a, *b;                     /* keys, scratch of the same size */
+    size_t   n, next;                   /* next: top bucket to hand out   */
+    unsigned bits;
+    int      nt, phase;                 /* 0 count, 1 scatter, 2 buckets  */
+    size_t (*off)[256];                 /* per thread: counts, then starts */
+    size_t   start[256];
+};
+
+struct msd_t {
+    _Alignas(64) unsigned char line[256][64];
+    struct msd_job *job;
+    int             id, err;
+    size_t          lo, hi;             /* input slice for the top pass  */
+    struct msd_w    w;
+};
+
+/* each phase forks nt - 1 threads and joins them; a thread that cannot
+   be created has its share run inline instead                          */
+static int msd_run(struct msd_job *j, int threads, unsigned flags,
+                   void *(*fn)(void *))
+{
+    struct msd_t **t;
+    pthread_t *th;
+    char *up;
+    int nt = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN), r = 0, k;
+
+    if (nt < 1 || j->n < MSD_PAR) nt = 1;
+    j->nt = nt;
+    j->off = calloc(nt, sizeof(*j->off));
+    t = calloc(nt, sizeof(*t));
+    th = calloc(nt, sizeof(*th));
+    up = calloc(nt, 1);
+    if (!j->off || !t || !th || !up) {
+        r = -ENOMEM;
+        goto out;
+    }
+    for (k = 0; k < nt && !r; ++k) {
+        if (!(t[k] = aligned_alloc(64, sizeof(**t)))) {
+            r = -ENOMEM;
+            break;
+        }
+        memset(t[k], 0, sizeof(**t));
+        t[k]->job = j;
+        t[k]->id = k;
+        t[k]->lo = j->n * k / nt;
+        t[k]->hi = j->n * (k + 1) / nt;
+        t[k]->w.s.fd = -1;
+        if (flags & VMS_MSD_SESSION) r = vms_open(&t[k]->w.s);
+    }
+    if (r) goto out;
+
+    for (j->phase = 0; j->phase < 3; ++j->phase) {
+        if (j->phase == 1)              /* per‑thread starts, bucket‑major */
+            for (size_t d = 0, at = 0; d < 256; ++d) {
+                j->start[d] = at;
+                for (k = 0; k < nt; ++k) {
+                    size_t c = j->off[k][d];
+                    j->off[k][d] = at;
+                    at += c;
+                }
+            }
+        for (k = 1; k < nt; ++k)
+            up[k] = !pthread_create(&th[k], NULL, fn, t[k]);
+        fn(t[0]);
+        for (k = 1; k < nt; ++k)
+            if (up[k]) pthread_join(th[k], NULL);
+            else fn(t[k]);
+    }
+    for (k = 0; k < nt && !r; ++k) r = t[k]->err;
+out:
+    for (k = 0; t && k < nt; ++k)
+        if (t[k]) {
+            vms_close(&t[k]->w.s);
+            free(t[k]);
+        }
+    free(up);
+    free(th);
+    free(t);
+    free(j->off);
+    return r;
+}
+
+#define KEY_T   uint32_t
+#define MSD(x)  msd32_##x
+#include "vmsort_msd.h"
+#undef MSD
+#undef KEY_T
+
+#define KEY_T   uint64_t
+#define MSD(x)  msd64_##x
+#include "vmsort_msd.h"
+#undef MSD
+#undef KEY_T
+
+int vms_sort32(uint32_t *a, size_t n, int threads, unsigned flags)
+{
+    return msd32_sort(a, n, threads, flags);
+}
+
+int vms_sort64(uint64_t *a, size_t n, int threads, unsigned flags)
+{
+    return msd64_sort(a, n, threads, flags);
+}
+
+/* ------------ sharded sort --------------------------------------- */
+#define SHARD_MAX  1024                 /* P * P partition counters       */
+
+/* shard p of P owns keys [shard_lo(p), shard_lo(p + 1)); (k * P) >> 16
+   is the p with shard_lo(p) <= k                                     */
+static uint32_t shard_lo(uint32_t p, uint32_t P)
+{
+    return (uint32_t)(((uint64_t)VMS_KEYS * p + P - 1) / P);
+}
+
+struct shard_job {
+    const uint16_t *in;
+    uint16_t       *tmp, *out;
+    size_t          n, *off;            /* off[t * P + p]: counts, then starts */
+    size_t         *start;              /* [P + 1] shard p in tmp / dup out  */
+    size_t         *uoff;               /* [P + 1] unique: counts, then starts */
+    uint32_t        P;
+    int             phase;              /* 0 count, 1 scatter, 2 fault, 3 out */
+    unsigned        flags;
+};
+
+struct shard_t {
+    struct shard_job *j;
+    uint32_t          id;
+    int               err;
+    struct vms        s;
+};
+
+static void *shard_thread(void *arg)
+{
+    struct shard_t *t = arg;
+    struct shard_job *j = t->j;
+    uint32_t P = j->P, p = t->id, lo = shard_lo(p, P), hi = shard_lo(p + 1, P);
+    const uint16_t *in = j->in + j->n * p / P;
+    size_t n = j->n * (p + 1) / P - j->n * p / P, *off = j->off + (size_t)p * P;
+
+    switch (j->phase) {
+    case 0:                             /* open on this CPU: local chunks */
+        if ((t->err = vms_open(&t->s))) break;
+        for (size_t i = 0; i < n; ++i) ++off[(uint32_t)in[i] * P >> 16];
+        break;
+    case 1:
+        for (size_t i = 0; i < n; ++i) j->tmp[off[(uint32_t)in[i] * P >> 16]++] = in[i];
+        break;
+    case 2: {
+        const uint16_t *k = j->tmp + j->start[p], *e = j->tmp + j->start[p + 1];
+        if (!(j->flags & VMS_SHARD_DUPS)) {
+            struct vmsort_range c = { .lo = lo, .hi = hi };
+            for (; k < e; ++k) vms_insert(&t->s, *k);
+            if (ioctl(t->s.fd, VMSORT_IOC_COUNT, &c)) t->err = -errno;
+            else j->uoff[p] = c.out;
+            break;
+        }
+        /* counted here, not in the key pages: a degraded session maps
+           several keys onto one shared page; the session only orders */
+        size_t *cnt = calloc(hi - lo, sizeof(*cnt));
+        uint16_t *u = malloc((hi - lo) * sizeof(*u)), *o = j->out + j->start[p];
+        long m = -ENOMEM;
+        if (cnt && u) {
+            for (; k < e; ++k)
+                if (!cnt[*k - lo]++) vms_insert(&t->s, *k);
+            m = vms_extract_range(&t->s, lo, hi, u, hi - lo, 0);
+        }
+        if (m < 0) t->err = (int)m;
+        for (long i = 0; i < m; ++i)
+            for (size_t c = cnt[u[i] - lo]; c; --c) *o++ = u[i];
+        free(cnt);
+        free(u);
+        break;
+    }
+    case 3: {
+        long m = vms_extract_range(&t->s, lo, hi, j->out + j->uoff[p],
+                                   (uint32_t)(j->uoff[p + 1] - j->uoff[p]), 0);
+        if (m < 0) t->err = (int)m;
+        break;
+    }
+    }
+    return NULL;
+}
+
+long vms_sort_sharded(const uint16_t *in, size_t n, uint16_t *out, int shards,
+                      unsigned flags)
+{
+    struct shard_job j = { .in = in, .out = out, .n = n, .flags = flags };
+    struct shard_t *t = NULL;
+    pthread_t *th = NULL;
+    pthread_attr_t *at = NULL;
+    char *up = NULL;
+    cpu_set_t mask;
+    int cpus[CPU_SETSIZE], nc = 0;
+    long r = 0;
+    uint32_t P, p, ready = 0;
+
+    if (!n) return 0;
+    if (!sched_getaffinity(0, sizeof(mask), &mask))
+        for (int c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &mask)) cpus[nc++] = c;
+    P = shards > 0 ? (uint32_t)shards : nc ? (uint32_t)nc : 1;
+    if (P > SHARD_MAX) P = SHARD_MAX;
+    j.P = P;
+
+    j.tmp = malloc(n * sizeof(*j.tmp));
+    j.off = calloc((size_t)P * P, sizeof(*j.off));
+    j.start = calloc(P + 1, sizeof(*j.start));
+    j.uoff = calloc(P + 1, sizeof(*j.uoff));
+    t = calloc(P, sizeof(*t));
+    th = calloc(P, sizeof(*th));
+    at = calloc(P, sizeof(*at));
+    up = calloc(P, 1);
+    if (!j.tmp || !j.off || !j.start || !j.uoff || !t || !th || !at || !up) {
+        r = -ENOMEM;
+        goto out;
+    }
+    for (p = 0; p < P; ++p) {
+        t[p] = (struct shard_t){ .j = &j, .id = p, .s = { .fd = -1 } };
+        pthread_attr_init(&at[p]);
+        if (nc) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpus[p % nc], &one);
+            pthread_attr_setaffinity_np(&at[p], sizeof(one), &one);
+        }
+    }
+    ready = P;
+
+    /* one fork/join per phase, every worker back on its own CPU; a
+       thread that cannot be created runs its share inline, unpinned */
+    for (j.phase = 0; j.phase < 4 && !r; ++j.phase) {
+        if (j.phase == 1)               /* per‑thread starts, shard‑major */
+            for (size_t q = 0, a = 0; q <= P; ++q) {
+                j.start[q] = a;
+                for (p = 0; q < P && p < P; ++p) {
+                    size_t c = j.off[(size_t)p * P + q];
+                    j.off[(size_t)p * P + q] = a;
+                    a += c;
+                }
+            }
+        if (j.phase == 3) {
+            if (flags & VMS_SHARD_DUPS) break;
+            for (size_t q = 0, a = 0; q <= P; ++q) {
+                size_t c = j.uoff[q];
+                j.uoff[q] = a;
+                a += c;
+            }
+        }
+        for (p = 0; p < P; ++p)
+            up[p] = !pthread_create(&th[p], &at[p], shard_thread, &t[p]);
+        for (p = 0; p < P; ++p)
+            if (up[p]) pthread_join(th[p], NULL);
+            else shard_thread(&t[p]);
+        for (p = 0; p < P && !r; ++p) r = t[p].err;
+    }
+    if (!r) r = flags & VMS_SHARD_DUPS ? (long)n : (long)j.uoff[P];
+out:
+    for (p = 0; p < ready; ++p) {
+        vms_close(&t[p].s);
+        pthread_attr_destroy(&at[p]);
+    }
+    free(up);
+    free(at);
+    free(th);
+    free(t);
+    free(j.uoff);
+    free(j.start);
+    free(j.off);
+    free(j.tmp);
+    return r;
+}
+
+/* ------------ decoders ------------------------------------------- */
+/* byte -> its set‑bit positions, for the bitmap decoder */
+static uint8_t bit_pos[256][8];
+
+static void __attribute__((constructor)) init_bit_pos(void)
+{
+    for (int b = 0; b < 256; ++b)
+        for (int i = 0, n = 0; i < 8; ++i)
+            if (b >> i & 1) bit_pos[b][n++] = i;
+}
+
+/* at most lim keys into out[lim + 8]; more set bits is -EINVAL */
+static long dec_bitmap(const uint64_t *l0, uint16_t *out, size_t lim)
+{
+    size_t n = 0;
+    for (uint32_t w = 0; w < 1024; ++w) {
+        uint64_t bits = l0[w];
+        if (!bits) continue;
+        if (n + __builtin_popcountll(bits) > lim) return -EINVAL;
+        for (uint32_t by = 0; by < 8; ++by, bits >>= 8) {
+            uint8_t b = bits & 0xFF;
+            if (!b) continue;
+            uint16_t base = w * 64 + by * 8;
+#ifdef __SSE2__
+            /* 8 positions at once; out has 8 slots of slack (see caller) */
+            __m128i p = _mm_loadl_epi64((const __m128i *)bit_pos[b]);
+            p = _mm_add_epi16(_mm_unpacklo_epi8(p, _mm_setzero_si128()),
+                              _mm_set1_epi16(base));
+            _mm_storeu_si128((__m128i *)(out + n), p);
+            n += __builtin_popcount(b);
+#else
+            for (int i = 0; i < __builtin_popcount(b); ++i)
+                out[n++] = base + bit_pos[b][i];
+#endif
+        }
+    }
+    return n;
+}
+
+static long dec_varint(const uint8_t *p, const uint8_t *end, uint16_t *out, size_t n)
+{
+    int32_t prev = -1;
+    size_t i = 0;
+    while (i < n) {
+#ifdef __SSE2__
+        /* 16 one‑byte gaps: widen, +1, prefix‑sum, add prev */
+        if (end - p >= 16 && n - i >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+            if (!_mm_movemask_epi8(v)) {
+                __m128i z = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+                /* the last key is prev + byte sum + 16; the lanes would wrap */
+                __m128i sad = _mm_sad_epu8(v, z);
+                if (prev + 16 + _mm_cvtsi128_si32(sad) +
+                    _mm_cvtsi128_si32(_mm_srli_si128(sad, 8)) > 0xFFFF)
+                    return -EINVAL;
+                __m128i a = _mm_add_epi16(_mm_unpacklo_epi8(v, z), one);
+                __m128i b = _mm_add_epi16(_mm_unpackhi_epi8(v, z), one);
+                a = _mm_add_epi16(a, _mm_slli_si128(a, 2));
+                b = _mm_add_epi16(b, _mm_slli_si128(b, 2));
+                a = _mm_add_epi16(a, _mm_slli_si128(a, 4));
+                b = _mm_add_epi16(b, _mm_slli_si128(b, 4));
+                a = _mm_add_epi16(a, _mm_slli_si128(a, 8));
+                b = _mm_add_epi16(b, _mm_slli_si128(b, 8));
+                a = _mm_add_epi16(a, _mm_set1_epi16((int16_t)prev));
+                b = _mm_add_epi16(b, _mm_set1_epi16((int16_t)_mm_extract_epi16(a, 7)));
+                _mm_storeu_si128((__m128i *)(out + i), a);
+                _mm_storeu_si128((__m128i *)(out + i + 8), b);
+                prev = (uint16_t)_mm_extract_epi16(b, 7);
+                i += 16; p += 16;
+                continue;
+            }
+        }
+#endif
+        uint32_t gap = 0;
+        for (int sh = 0;; sh += 7) {
+            if (p == end || sh > 14) return -EINVAL;
+            uint8_t c = *p++;
+            gap |= (uint32_t)(c & 0x7F) << sh;
+            if (!(c & 0x80)) break;
+        }
+        prev += gap + 1;
+        if (prev > 0xFFFF) return -EINVAL;
+        out[i++] = prev;
+    }
+    return p == end ? (long)n : -EINVAL;
+}
+
+static long dec_ef(const uint64_t *low, size_t words, uint32_t l, uint16_t *out, size_t n)
+{
+    size_t nlow = (n * l + 63) / 64, nhigh = (n + (65536 >> l) + 63) / 64;
+    if (words != nlow + nhigh) return -EINVAL;
+    const uint64_t *high = low + nlow;
+    size_t i = 0;
+    for (size_t w = 0; w < nhigh && i < n; ++w)
+        for (uint64_t bits = high[w]; bits && i < n; bits &= bits - 1, ++i) {
+            uint64_t hi = w * 64 + __builtin_ctzll(bits) - i, lo = 0, pos = i * l;
+            if (l) {
+                lo = low[pos / 64] >> (pos % 64);
+                if (pos % 64 + l > 64) lo |= low[pos / 64 + 1] << (64 - pos % 64);
+                lo &= (1U << l) - 1;
+            }
+            out[i] = hi << l | lo;
+        }
+    return i == n ? (long)n : -EINVAL;
+}
+
+static long dec_runs(const uint16_t *r, size_t nruns, uint16_t *out, size_t n)
+{
+    size_t i = 0;
+    for (size_t k = 0; k < nruns; ++k) {
+        uint32_t start = r[2 * k], len = r[2 * k + 1] + 1u;
+        if (start + len > 65536 || i + len > n) return -EINVAL;
+        uint32_t j = 0;
+#ifdef __SSE2__
+        __m128i v = _mm_add_epi16(_mm_set1_epi16((int16_t)start),
+                                  _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+        for (; j + 8 <= len; j += 8, v = _mm_add_epi16(v, _mm_set1_epi16(8)))
+            _mm_storeu_si128((__m128i *)(out + i + j), v);
+#endif
+        for (; j < len; ++j) out[i + j] = start + j;
+        i += len;
+    }
+    return i == n ? (long)n : -EINVAL;
+}
+
+long vms_decode(const void *buf, size_t len, uint16_t *out, size_t cap)
+{
+    const struct vmsort_enc_hdr *h = buf;
+    if (len < sizeof(*h)) return -EINVAL;
+    const uint8_t *p = (const uint8_t *)(h + 1);
+    size_t plen = len - sizeof(*h), n = h->keys;
+    if (n > VMS_KEYS) return -EINVAL;
+    if (n > cap) return -ENOSPC;
+
+    switch (h->fmt) {
+    case VMSORT_FMT_U16:
+        if (plen != n * 2) return -EINVAL;
+        memcpy(out, p, plen);
+        return n;
+    case VMSORT_FMT_VARINT:
+        return dec_varint(p, p + plen, out, n);
+    case VMSORT_FMT_EF:
+        if (plen % 8 || h->param > 16) return -EINVAL;
+        return dec_ef((const uint64_t *)p, plen / 8, h->param, out, n);
+    case VMSORT_FMT_RUNS:
+        if (plen % 4) return -EINVAL;
+        return dec_runs((const uint16_t *)p, plen / 4, out, n);
+    case VMSORT_FMT_BITMAP: {
+        if (plen != 65536 / 8) return -EINVAL;
+        /* the SIMD path stores 8 keys per byte; bounce when out has no slack */
+        uint16_t *t = cap >= n + 8 ? out : malloc((n + 8) * 2);
+        if (!t) return -ENOMEM;
+        long got = dec_bitmap((const uint64_t *)p, t, n);
+        if (t != out) {
+            if (got > 0) memcpy(out, t, got * 2);
+            free(t);
+        }
+        return got == (long)n ? got : -EINVAL;
+    }
+    }
+    return -EINVAL;
+}
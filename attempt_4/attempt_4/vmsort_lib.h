@@ -0,0 +1,190 @@
+/* vmsort_lib.h  —  userspace helpers for /dev/vmsort sessions */
+#ifndef VMSORT_LIB_H_
+#define VMSORT_LIB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vmsort_uapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VMS_WIN     (256UL << 20)       /* window: one 4 KiB page per key */
+#define VMS_STRIDE  4096
+#define VMS_KEYS    65536
+
+/* one open + mapped session */
+struct vms { int fd; volatile uint8_t *base; };
+
+int  vms_open(struct vms *s);           /* 0 or -errno                    */
+void vms_close(struct vms *s);
+
+/* first touch of a key's page faults it into the session bitmap */
+static inline void vms_insert(struct vms *s, uint16_t k)
+{
+    s->base[(size_t)k * VMS_STRIDE] = 1;
+}
+
+/* the key's page is ordinary zeroed memory after the fault, so its
+   first word doubles as an occurrence counter (fresh sessions only)  */
+static inline volatile uint64_t *vms_counter(struct vms *s, uint16_t k)
+{
+    return (volatile uint64_t *)(s->base + (size_t)k * VMS_STRIDE);
+}
+
+static inline void vms_count(struct vms *s, uint16_t k)
+{
+    ++*vms_counter(s, k);
+}
+
+/* sorted unique keys into out[cap]; returns the count or -errno */
+long vms_extract(struct vms *s, uint16_t *out, uint32_t cap);
+
+/* keys of [lo, hi) into out[cap], ascending or (desc) descending; the
+   scan stops at cap.  Returns the count or -errno                    */
+long vms_extract_range(struct vms *s, uint32_t lo, uint32_t hi,
+                       uint16_t *out, uint32_t cap, int desc);
+
+/* the n smallest keys ascending / the n largest descending */
+static inline long vms_bottom(struct vms *s, uint16_t *out, uint32_t n)
+{
+    return vms_extract_range(s, 0, VMS_KEYS, out, n, 0);
+}
+
+static inline long vms_top(struct vms *s, uint16_t *out, uint32_t n)
+{
+    return vms_extract_range(s, 0, VMS_KEYS, out, n, 1);
+}
+
+/* keys inserted since the previous call, sorted, into out[cap]; keys
+   beyond cap are kept for the next call.  Returns the count or -errno */
+long vms_extract_delta(struct vms *s, uint16_t *out, uint32_t cap);
+
+/* segmented mode: local key k of segment seg, segments 1 << shift wide */
+static inline void vms_seg_insert(struct vms *s, unsigned shift, uint32_t seg,
+                                  uint16_t k)
+{
+    vms_insert(s, (uint16_t)(seg << shift | k));
+}
+
+/* every segment sorted in one call: local keys into out[cap], segment i
+   at out[offs[i] .. offs[i + 1]), offs[(65536 >> shift) + 1].  flags
+   VMSORT_SEG_RESET empties the session afterwards.  Returns the key
+   count, or -ENOSPC (nothing written), or -errno                     */
+long vms_segments(struct vms *s, unsigned shift, uint16_t *out, uint32_t cap,
+                  uint32_t *offs, uint32_t flags);
+
+/* pin out[cap] (cap <= VMS_KEYS) as the session's output buffer, or
+   unpin with out = NULL; 0 or -errno                                 */
+int vms_pin(struct vms *s, uint16_t *out, uint32_t cap);
+
+/* sorted keys of [lo, hi) straight into the pinned buffer at key offset
+   off, at most cap of them; returns the count or -errno             */
+long vms_extract_pinned(struct vms *s, uint32_t lo, uint32_t hi,
+                        uint32_t off, uint32_t cap);
+
+/* encoded extraction (VMSORT_FMT_*, or VMSORT_FMT_AUTO) into buf[cap];
+   returns bytes written, or -ENOSPC with *need set, or -errno        */
+long vms_extract_enc(struct vms *s, void *buf, uint32_t cap, uint32_t fmt,
+                     uint32_t *need);
+
+/* decode any encoded extraction into sorted keys; SSE2 fast paths for
+   VARINT, RUNS and BITMAP.  Returns keys decoded, -ENOSPC if cap is too
+   small, -EINVAL on a malformed buffer                                */
+long vms_decode(const void *buf, size_t len, uint16_t *out, size_t cap);
+
+/* session image (VMSORT_IMG_COUNTS to include vms_counter values) into
+   buf[cap]; returns bytes, or -ENOSPC with *need set, or -errno
+   (-EOPNOTSUPP: counts asked of a degraded session)                  */
+long vms_save(struct vms *s, void *buf, uint32_t cap, uint32_t flags,
+              uint32_t *need);
+
+/* load an image into a freshly opened session without faulting;
+   returns the number of keys or -errno                               */
+long vms_restore(struct vms *s, const void *buf, uint32_t len);
+
+/* the same through a file; 0 / keys, or -errno                       */
+int  vms_save_file(struct vms *s, const char *path, uint32_t flags);
+long vms_restore_file(struct vms *s, const char *path);
+
+/* pre‑build the window's page tables (no leaf PTEs); 0 or -errno */
+int vms_prepare(struct vms *s);
+
+/* chunk memory budget in bytes (0 = unlimited); returns bytes held or
+   -errno.  Over budget the session degrades instead of failing faults */
+long long vms_budget(struct vms *s, uint64_t bytes);
+
+/* ---- bucket priority queue ------------------------------------- */
+/* priorities are keys; each bucket is its key's page: an entry count
+   (the vms_counter word), the first VMS_PQ_ITEMS u32 payloads and an
+   owner tag, the rest in a malloc'd spill array; popped LIFO.
+   cand[ic..nc) holds every non‑empty bucket below hz, fetched
+   VMS_PQ_BATCH at a time with VMSORT_IOC_PQ_NEXT; pushes below hz patch
+   it.  A degraded session backs several keys with one page; the tag
+   (prio + 1) catches that and the push fails with -ENOMEM instead of
+   mixing buckets.  One thread per queue.                              */
+#define VMS_PQ_ITEMS  ((VMS_STRIDE - 12) / 4)
+#define VMS_PQ_BATCH  64
+
+struct vms_bucket { uint64_t n; uint32_t item[VMS_PQ_ITEMS]; uint32_t tag; };
+
+struct vms_pq {
+    struct vms s;
+    uint32_t   ic, nc, hz;              /* resumable min cursor        */
+    uint16_t   cand[VMS_PQ_BATCH];
+    uint32_t **spill;                   /* [VMS_KEYS], allocated on use */
+};
+
+static inline struct vms_bucket *vms_pq_bucket(struct vms_pq *q, uint16_t prio)
+{
+    return (struct vms_bucket *)(q->s.base + (size_t)prio * VMS_STRIDE);
+}
+
+int  vms_pq_open(struct vms_pq *q);     /* 0 or -errno                    */
+void vms_pq_close(struct vms_pq *q);
+
+/* 0, or -ENOMEM (no spill memory, or prio's page is shared) */
+int  vms_pq_push(struct vms_pq *q, uint16_t prio, uint32_t item);
+
+/* smallest priority and its most recent item; 0 or -ENOENT if empty */
+int  vms_pq_peek(struct vms_pq *q, uint16_t *prio, uint32_t *item);
+int  vms_pq_pop(struct vms_pq *q, uint16_t *prio, uint32_t *item);
+
+/* move item from bucket old to prio; -ENOENT if old does not hold it,
+   or -ENOMEM                                                         */
+int  vms_pq_decrease(struct vms_pq *q, uint32_t item, uint16_t old, uint16_t prio);
+
+/* ---- wide keys -------------------------------------------------- */
+/* sort 32/64‑bit keys in place, duplicates kept: an MSD radix split
+   on the bits above the low 16, then each bucket's low 16 bits through
+   a 16‑bit bitmap per worker, or with VMS_MSD_SESSION through one
+   /dev/vmsort session per worker (SEGMENTS + RESET between buckets).
+   threads <= 0: one per online CPU.  0, or -errno with a[] permuted */
+#define VMS_MSD_SESSION  (1U << 0)
+
+int vms_sort32(uint32_t *a, size_t n, int threads, unsigned flags);
+int vms_sort64(uint64_t *a, size_t n, int threads, unsigned flags);
+
+/* ---- sharded sort ---------------------------------------------- */
+/* in[n] sorted into out[n] by P sessions, one per worker thread pinned
+   to its own CPU of the affinity mask.  Shard p owns the contiguous key
+   range [ceil(65536p / P), ceil(65536(p + 1) / P)); the workers split
+   the input by shard, fault their shard into their own window and
+   extract it straight to its place in out, so there is no merge.
+   VMS_SHARD_DUPS keeps duplicates (counted in a per‑shard table, not in
+   the key pages), otherwise keys come out unique.  shards <= 0: one per
+   CPU; at most 1024.  Returns the number of keys written, or -errno   */
+#define VMS_SHARD_DUPS  (1U << 0)
+
+long vms_sort_sharded(const uint16_t *in, size_t n, uint16_t *out, int shards,
+                      unsigned flags);
+
+/* counter from /proc/self/fdinfo (e.g. "alloc_fallback"), 0 if absent */
+uint64_t vms_stat(struct vms *s, const char *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VMSORT_LIB_H_ */
@@ -0,0 +1,153 @@
+/* vmsort_msd.h  —  MSD pipeline body, one copy per key width
+ *
+ * Included by vmsort_lib.c only, once per key type, with KEY_T set to
+ * the key type and MSD(x) naming x for it.  No include guard on purpose.
+ *
+ * A parallel top‑byte pass scatters a[] into b[] through per‑thread
+ * write‑combining lines (msd_run phases 0 and 1); in phase 2 workers
+ * take top buckets one at a time
+ * and split them a byte at a time (single‑threaded, cache resident)
+ * until only the low 16 bits differ, where msd_w's backend sorts them.
+ */
+
+#define MSD_LINE  (64 / sizeof(KEY_T))  /* keys per write‑combining line  */
+
+static void MSD(isort)(KEY_T *a, size_t n)
+{
+    for (size_t i = 1; i < n; ++i) {
+        KEY_T k = a[i];
+        size_t j = i;
+        for (; j && a[j - 1] > k; --j) a[j] = a[j - 1];
+        a[j] = k;
+    }
+}
+
+/* src[n] shares every bit above the low 16; sorted into dst (may be src) */
+static int MSD(leaf)(struct msd_w *w, const KEY_T *src, KEY_T *dst, size_t n)
+{
+    KEY_T pre = src[0] & ~(KEY_T)0xFFFF;
+    size_t o = 0;
+
+    if (w->s.fd >= 0) {
+        if (!++w->gen) {
+            memset(w->tag, 0, sizeof(w->tag));
+            w->gen = 1;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint16_t lo = (uint16_t)src[i];
+            if (w->tag[lo] != w->gen) {
+                w->tag[lo] = w->gen;
+                w->cnt[lo] = 1;
+                vms_insert(&w->s, lo);
+            } else {
+                ++w->cnt[lo];
+            }
+        }
+        long u = vms_segments(&w->s, 16, w->lows, VMS_KEYS, w->offs, VMSORT_SEG_RESET);
+        if (u < 0) return (int)u;
+        for (long j = 0; j < u; ++j)
+            for (uint32_t c = w->cnt[w->lows[j]]; c; --c)
+                dst[o++] = pre | w->lows[j];
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        uint16_t lo = (uint16_t)src[i];
+        uint64_t *x = &w->l0[lo >> 6], m = 1ULL << (lo & 63);
+        if (*x & m) {
+            ++w->cnt[lo];
+            continue;
+        }
+        if (!*x) w->l1[lo >> 12] |= 1ULL << (lo >> 6 & 63);
+        *x |= m;
+        w->cnt[lo] = 1;
+    }
+    for (unsigned j = 0; j < 16; ++j) {
+        for (uint64_t y = w->l1[j]; y; y &= y - 1) {
+            unsigned wi = j << 6 | __builtin_ctzll(y);
+            for (uint64_t x = w->l0[wi]; x; x &= x - 1) {
+                uint16_t lo = (uint16_t)(wi << 6 | __builtin_ctzll(x));
+                for (uint32_t c = w->cnt[lo]; c; --c) dst[o++] = pre | lo;
+            }
+            w->l0[wi] = 0;
+        }
+        w->l1[j] = 0;
+    }
+    return 0;
+}
+
+/* a[n] / b[n] are the same slice of both buffers, keys in b if in_b;
+   bits at and above hi are equal, result lands in a               */
+static int MSD(rec)(struct msd_w *w, KEY_T *a, KEY_T *b, size_t n,
+                    unsigned hi, int in_b)
+{
+    KEY_T *src = in_b ? b : a, *dst = in_b ? a : b;
+    size_t cnt[256] = {0}, pos[256];
+    unsigned sh = hi - 8;
+    int r;
+
+    if (n <= MSD_SMALL) {
+        if (in_b) memcpy(a, b, n * sizeof(KEY_T));
+        MSD(isort)(a, n);
+        return 0;
+    }
+    if (hi == 16) return MSD(leaf)(w, src, a, n);
+
+    for (size_t i = 0; i < n; ++i) ++cnt[src[i] >> sh & 0xFF];
+    if (cnt[src[0] >> sh & 0xFF] == n)  /* one sub‑bucket: nothing to move */
+        return MSD(rec)(w, a, b, n, sh, in_b);
+    for (size_t d = 0, at = 0; d < 256; at += cnt[d++]) pos[d] = at;
+    for (size_t i = 0; i < n; ++i) dst[pos[src[i] >> sh & 0xFF]++] = src[i];
+    for (size_t d = 0, at = 0; d < 256; at += cnt[d++])
+        if (cnt[d] && (r = MSD(rec)(w, a + at, b + at, cnt[d], sh, !in_b)))
+            return r;
+    return 0;
+}
+
+static void *MSD(thread)(void *arg)
+{
+    struct msd_t *t = arg;
+    struct msd_job *j = t->job;
+    const KEY_T *src = (const KEY_T *)j->a + t->lo;
+    KEY_T *b = j->b, (*line)[MSD_LINE] = (void *)t->line;
+    size_t n = t->hi - t->lo, *pos = j->off[t->id];
+    unsigned sh = j->bits - 8;
+
+    if (j->phase == 0) {
+        for (size_t i = 0; i < n; ++i) ++pos[src[i] >> sh];
+    } else if (j->phase == 1) {
+        uint8_t fill[256] = {0};
+        for (size_t i = 0; i < n; ++i) {
+            unsigned d = src[i] >> sh;
+            line[d][fill[d]++] = src[i];
+            if (fill[d] == MSD_LINE) {
+                memcpy(b + pos[d], line[d], sizeof(line[d]));
+                pos[d] += MSD_LINE;
+                fill[d] = 0;
+            }
+        }
+        for (unsigned d = 0; d < 256; ++d)
+            memcpy(b + pos[d], line[d], fill[d] * sizeof(KEY_T));
+    } else {
+        for (size_t d; !t->err && (d = __atomic_fetch_add(&j->next, 1, __ATOMIC_RELAXED)) < 256; ) {
+            size_t at = j->start[d], m = (d < 255 ? j->start[d + 1] : j->n) - at;
+            if (m) t->err = MSD(rec)(&t->w, (KEY_T *)j->a + at, b + at, m, sh, 1);
+        }
+    }
+    return NULL;
+}
+
+static int MSD(sort)(KEY_T *a, size_t n, int threads, unsigned flags)
+{
+    if (n <= MSD_SMALL) {
+        MSD(isort)(a, n);
+        return 0;
+    }
+    struct msd_job j = { .a = a, .n = n, .bits = 8 * sizeof(KEY_T) };
+    j.b = malloc(n * sizeof(KEY_T));
+    int r = j.b ? msd_run(&j, threads, flags, MSD(thread)) : -ENOMEM;
+    free(j.b);
+    return r;
+}
+
+#undef MSD_LINE
@@ -0,0 +1,315 @@
+/* vmsort_sort.c  —  file‑to‑file sort of binary u16 keys through vmsort
+ *
+ *   vmsort-sort [-u | -c] [-j sessions] [-D] [-b] in.bin out.bin
+ *
+ *   default  sorted keys, duplicates kept   (u16 per key)
+ *   -u       sorted unique keys             (u16 per key)
+ *   -c       sorted (key, count) records    (u64 key, u64 count)
+ *   -j N     N inserter threads, one session each (default 1)
+ *   -D       write output with O_DIRECT instead of mmap
+ *   -b       also time in‑memory qsort / radix‑256 on the same input
+ *
+ * A reader thread streams the MADV_SEQUENTIAL input mapping ahead of the
+ * inserters in BATCH‑key batches; each inserter counts keys in its own
+ * table and faults a key into its own session on the first occurrence.
+ * The session only orders the keys: its pages are not used as counters,
+ * since fallback chunks and the budget sink page alias them.  The output
+ * order is the sessions' extracted lists, merged when there are several;
+ * the tables only supply each key's multiplicity.
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "vmsort_lib.h"
+
+#define BATCH     (1UL << 20)           /* keys per pipeline batch        */
+#define AHEAD     4                     /* batches the reader runs ahead  */
+#define OUTBUF    (1UL << 20)           /* output staging, O_DIRECT‑aligned */
+
+enum { OUT_SORTED, OUT_UNIQUE, OUT_COUNTED };
+
+static uint64_t now_ns(void)
+{
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static void die(const char *what) { perror(what); exit(1); }
+
+/* ------------ reader / inserter pipeline ------------------------- */
+struct pipe {
+    const uint16_t *in; size_t n, nbatch;
+    size_t ready;                       /* batches paged in by reader   */
+    size_t next;                        /* next batch to hand out       */
+    pthread_mutex_t mu; pthread_cond_t cv;
+};
+
+static void *reader(void *p)
+{
+    struct pipe *pp = p;
+    const size_t bbytes = BATCH * 2;
+    for (size_t b = 0; b < pp->nbatch; ++b) {
+        const uint8_t *lo = (const uint8_t *)pp->in + b * bbytes;
+        size_t len = b + 1 == pp->nbatch ? pp->n * 2 - b * bbytes : bbytes;
+        volatile uint8_t sink = 0;
+        madvise((void *)((uintptr_t)lo & ~4095UL), len + ((uintptr_t)lo & 4095),
+                MADV_WILLNEED);
+        for (size_t o = 0; o < len; o += 4096) sink += lo[o];  /* page in */
+        (void)sink;
+
+        pthread_mutex_lock(&pp->mu);
+        pp->ready = b + 1;
+        pthread_cond_broadcast(&pp->cv);
+        while (pp->ready >= pp->next + AHEAD && pp->ready < pp->nbatch)
+            pthread_cond_wait(&pp->cv, &pp->mu);
+        pthread_mutex_unlock(&pp->mu);
+    }
+    return NULL;
+}
+
+struct inserter { struct pipe *pp; struct vms s; uint64_t *cnt; /* [VMS_KEYS] */ };
+
+static void *insert(void *p)
+{
+    struct inserter *w = p; struct pipe *pp = w->pp;
+    for (;;) {
+        pthread_mutex_lock(&pp->mu);
+        size_t b = pp->next;
+        if (b >= pp->nbatch) { pthread_mutex_unlock(&pp->mu); break; }
+        pp->next++;
+        pthread_cond_broadcast(&pp->cv);
+        while (pp->ready <= b) pthread_cond_wait(&pp->cv, &pp->mu);
+        pthread_mutex_unlock(&pp->mu);
+
+        size_t lo = b * BATCH, hi = lo + BATCH < pp->n ? lo + BATCH : pp->n;
+        for (size_t i = lo; i < hi; ++i)
+            if (!w->cnt[pp->in[i]]++) vms_insert(&w->s, pp->in[i]);
+    }
+    return NULL;
+}
+
+/* ------------ output sink: mmap or O_DIRECT ---------------------- */
+struct sink { int fd, direct; uint8_t *map, *buf; size_t size, off, fill; };
+
+static void sink_open(struct sink *o, const char *path, size_t size, int direct)
+{
+    memset(o, 0, sizeof(*o));
+    o->size = size; o->direct = direct;
+    o->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+    if (o->fd < 0) die(path);
+    if (ftruncate(o->fd, size)) die("ftruncate");
+    if (direct) {
+        if (posix_memalign((void **)&o->buf, 4096, OUTBUF)) die("posix_memalign");
+    } else if (size) {
+        o->map = mmap(NULL, size, PROT_WRITE, MAP_SHARED, o->fd, 0);
+        if (o->map == MAP_FAILED) die("mmap output");
+        madvise(o->map, size, MADV_SEQUENTIAL);
+    }
+}
+
+static void sink_flush(struct sink *o)
+{
+    /* O_DIRECT wants whole blocks: pad the tail, trim in sink_close */
+    size_t len = (o->fill + 4095) & ~4095UL;
+    memset(o->buf + o->fill, 0, len - o->fill);
+    if (pwrite(o->fd, o->buf, len, o->off) != (ssize_t)len) die("pwrite");
+    o->off += o->fill; o->fill = 0;
+}
+
+static void sink_write(struct sink *o, const void *p, size_t len)
+{
+    if (!o->direct) {
+        memcpy(o->map + o->off, p, len); o->off += len; return;
+    }
+    while (len) {
+        size_t k = OUTBUF - o->fill < len ? OUTBUF - o->fill : len;
+        memcpy(o->buf + o->fill, p, k);
+        o->fill += k; p = (const uint8_t *)p + k; len -= k;
+        if (o->fill == OUTBUF) sink_flush(o);
+    }
+}
+
+static void sink_close(struct sink *o)
+{
+    if (o->direct) {
+        if (o->fill) sink_flush(o);
+        if (ftruncate(o->fd, o->size)) die("ftruncate");
+        free(o->buf);
+    } else if (o->map) {
+        munmap(o->map, o->size);
+    }
+    assert(o->off == o->size);
+    close(o->fd);
+}
+
+/* ------------ in‑memory baselines (-b) --------------------------- */
+static int cmp16(const void *x, const void *y)
+{
+    uint16_t a = *(const uint16_t *)x, b = *(const uint16_t *)y;
+    return (a > b) - (a < b);
+}
+
+static void radix256(uint16_t *a, size_t n)
+{
+    uint16_t *aux = malloc(n * 2); if (!aux) die("malloc");
+    size_t cnt[256], pos[256];
+    for (int pass = 0; pass < 2; ++pass) {
+        int shift = pass ? 8 : 0;
+        memset(cnt, 0, sizeof(cnt));
+        for (size_t i = 0; i < n; ++i) cnt[(a[i] >> shift) & 0xFF]++;
+        pos[0] = 0;
+        for (int i = 1; i < 256; ++i) pos[i] = pos[i - 1] + cnt[i - 1];
+        for (size_t i = 0; i < n; ++i) aux[pos[(a[i] >> shift) & 0xFF]++] = a[i];
+        memcpy(a, aux, n * 2);
+    }
+    free(aux);
+}
+
+static void baseline(const char *name, const uint16_t *in, size_t n, int radix)
+{
+    uint16_t *a = malloc(n * 2); if (!a) die("malloc");
+    memcpy(a, in, n * 2);
+    uint64_t t0 = now_ns();
+    if (radix) radix256(a, n); else qsort(a, n, 2, cmp16);
+    uint64_t dt = now_ns() - t0;
+    for (size_t i = 1; i < n; ++i) assert(a[i - 1] <= a[i]);
+    fprintf(stderr, "%-10s: %8.2f ms  %6.3f GB/s\n", name, dt / 1e6, n * 2.0 / dt);
+    free(a);
+}
+
+/* ------------ main ----------------------------------------------- */
+int main(int argc, char **argv)
+{
+    int mode = OUT_SORTED, jobs = 1, direct = 0, bench = 0, opt;
+    while ((opt = getopt(argc, argv, "ucj:Db")) != -1) {
+        switch (opt) {
+        case 'u': mode = OUT_UNIQUE; break;
+        case 'c': mode = OUT_COUNTED; break;
+        case 'j': jobs = atoi(optarg); break;
+        case 'D': direct = 1; break;
+        case 'b': bench = 1; break;
+        default: goto usage;
+        }
+    }
+    if (argc - optind != 2 || jobs < 1) {
+usage:
+        fprintf(stderr, "usage: %s [-u | -c] [-j sessions] [-D] [-b] in.bin out.bin\n",
+                argv[0]);
+        return 2;
+    }
+
+    /* ---- input ---------------------------------------------------- */
+    int ifd = open(argv[optind], O_RDONLY);
+    if (ifd < 0) die(argv[optind]);
+    struct stat st; if (fstat(ifd, &st)) die("fstat");
+    if (st.st_size % 2) { fprintf(stderr, "input is not a u16 array\n"); return 1; }
+    size_t n = st.st_size / 2;
+    const uint16_t *in = n ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, ifd, 0) : NULL;
+    if (in == MAP_FAILED) die("mmap input");
+    if (n) madvise((void *)in, st.st_size, MADV_SEQUENTIAL);
+
+    /* ---- insert --------------------------------------------------- */
+    uint64_t t0 = now_ns();
+    struct pipe pp = { .in = in, .n = n, .nbatch = (n + BATCH - 1) / BATCH,
+                       .mu = PTHREAD_MUTEX_INITIALIZER, .cv = PTHREAD_COND_INITIALIZER };
+    struct inserter *w = calloc(jobs, sizeof(*w));
+    pthread_t rt, *wt = calloc(jobs, sizeof(*wt));
+    if (!w || !wt) die("calloc");
+    for (int j = 0; j < jobs; ++j) {
+        int e = vms_open(&w[j].s);
+        if (e) { errno = -e; die("/dev/vmsort"); }
+        if (!(w[j].cnt = calloc(VMS_KEYS, sizeof(*w[j].cnt)))) die("calloc");
+        w[j].pp = &pp;
+    }
+    int e = pthread_create(&rt, NULL, reader, &pp);
+    if (e) { errno = e; die("pthread_create"); }
+    for (int j = 0; j < jobs; ++j)
+        if ((e = pthread_create(&wt[j], NULL, insert, &w[j]))) { errno = e; die("pthread_create"); }
+    pthread_join(rt, NULL);
+    for (int j = 0; j < jobs; ++j) pthread_join(wt[j], NULL);
+    uint64_t t1 = now_ns();
+
+    /* ---- extract, merge the sorted per-session lists --------------- */
+    uint16_t *keys = malloc(VMS_KEYS * 2), **lst = calloc(jobs, sizeof(*lst));
+    uint64_t *cnt = malloc(VMS_KEYS * sizeof(*cnt));      /* [i]: of keys[i] */
+    long *len = calloc(jobs, sizeof(*len)), *at = calloc(jobs, sizeof(*at));
+    if (!keys || !lst || !cnt || !len || !at) die("malloc");
+    for (int j = 0; j < jobs; ++j) {
+        if (!(lst[j] = jobs == 1 ? keys : malloc(VMS_KEYS * 2))) die("malloc");
+        len[j] = vms_extract(&w[j].s, lst[j], VMS_KEYS);
+        if (len[j] < 0) { errno = -len[j]; die("extract"); }
+        vms_close(&w[j].s);
+    }
+    size_t uniq = 0, total = 0;
+    if (jobs == 1) {
+        for (uniq = 0; uniq < (size_t)len[0]; ++uniq)
+            total += cnt[uniq] = w[0].cnt[keys[uniq]];
+    } else {
+        for (;;) {                      /* smallest head, summed over lists */
+            int m = -1;
+            for (int j = 0; j < jobs; ++j)
+                if (at[j] < len[j] && (m < 0 || lst[j][at[j]] < lst[m][at[m]])) m = j;
+            if (m < 0) break;
+            uint16_t k = lst[m][at[m]];
+            uint64_t c = 0;
+            for (int j = 0; j < jobs; ++j)
+                if (at[j] < len[j] && lst[j][at[j]] == k) { c += w[j].cnt[k]; ++at[j]; }
+            keys[uniq] = k;
+            total += cnt[uniq++] = c;
+        }
+        for (int j = 0; j < jobs; ++j) free(lst[j]);
+    }
+    for (int j = 0; j < jobs; ++j) free(w[j].cnt);
+    free(lst); free(len); free(at);
+    if (total != n) {                   /* a key the sessions never saw */
+        fprintf(stderr, "extracted %zu of %zu keys\n", total, n);
+        return 1;
+    }
+    uint64_t t2 = now_ns();
+
+    /* ---- output --------------------------------------------------- */
+    size_t osize = mode == OUT_SORTED ? n * 2 :
+                   mode == OUT_UNIQUE ? uniq * 2 : uniq * 16;
+    struct sink o; sink_open(&o, argv[optind + 1], osize, direct);
+    if (mode == OUT_UNIQUE) {
+        sink_write(&o, keys, uniq * 2);
+    } else if (mode == OUT_COUNTED) {
+        for (size_t i = 0; i < uniq; ++i) {
+            uint64_t rec[2] = { keys[i], cnt[i] };
+            sink_write(&o, rec, sizeof(rec));
+        }
+    } else {
+        uint16_t run[4096];
+        for (size_t i = 0; i < uniq; ++i) {
+            uint64_t c = cnt[i];
+            for (size_t r = 0; r < 4096 && r < c; ++r) run[r] = keys[i];
+            for (; c; c -= c < 4096 ? c : 4096)
+                sink_write(&o, run, (c < 4096 ? c : 4096) * 2);
+        }
+    }
+    sink_close(&o);
+    uint64_t t3 = now_ns();
+
+    fprintf(stderr, "vmsort    : %8.2f ms  %6.3f GB/s  (insert %.2f, extract %.2f, "
+                    "write %.2f ms; %zu keys, %zu unique, %d session%s)\n",
+            (t3 - t0) / 1e6, n * 2.0 / (t3 - t0), (t1 - t0) / 1e6, (t2 - t1) / 1e6,
+            (t3 - t2) / 1e6, n, uniq, jobs, jobs > 1 ? "s" : "");
+    if (bench && n) {
+        baseline("qsort", in, n, 0);
+        baseline("radix256", in, n, 1);
+    }
+
+    free(cnt); free(keys); free(w); free(wt);
+    if (n) munmap((void *)in, st.st_size);
+    close(ifd);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#ifndef VMSORT_STATS_H_
+#define VMSORT_STATS_H_
+
+#include <linux/percpu.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+
+/* ------------------------------------------------------------------ */
+/* Per‑CPU counters and log2(ns) latency histograms                   */
+/* ------------------------------------------------------------------ */
+enum vmsort_ctr {
+        VS_FAULT,               /* faults handled                     */
+        VS_FAULT_NULL,          /* ... of which in null‑handler mode   */
+        VS_ALLOC_HUGE,          /* order‑9 chunk allocations          */
+        VS_ALLOC_FALLBACK,      /* order‑0 fallback allocations       */
+        VS_ALLOC_FAIL,          /* no chunk: budget or allocator      */
+        VS_ALLOC_LOST,          /* lost the chunk install cmpxchg     */
+        VS_BM_NEW,              /* vmsort_bm_set: key newly set       */
+        VS_BM_DUP,              /* vmsort_bm_set: key already present */
+        VS_EXTRACT,             /* extraction calls                   */
+        VS_EXTRACT_KEYS,        /* keys emitted by extraction         */
+        VS_SNAPSHOT,            /* snapshot generations taken         */
+        VS_EPOCH,               /* epoch flips                        */
+        VS_SETOP,               /* set algebra calls                  */
+        VS_ENCODE,              /* encoded extractions                */
+        VS_ENCODE_BYTES,        /* ... bytes produced                 */
+        VS_PIN,                 /* output buffers pinned              */
+        VS_PIN_EXTRACT,         /* extractions into the pinned buffer */
+        VS_READ,                /* read()/splice() calls              */
+        VS_READ_SEEK,           /* ... that had to select by rank     */
+        VS_SAVE,                /* session images saved               */
+        VS_RESTORE,             /* ... and restored                   */
+        VS_CHUNK_RECLAIM,       /* chunks freed by the shrinker       */
+        VS_CHUNK_REALLOC,       /* ... and allocated again on use     */
+        VS_DEGRADE_SMALL,       /* budget forced an order‑0 chunk     */
+        VS_DEGRADE_SINK,        /* no chunk: fault mapped the sink    */
+        VS_PREPARE,             /* page‑table prebuilds               */
+        VS_URING,               /* io_uring commands                  */
+        VS_URING_PUNT,          /* ... sent to io‑wq (-EAGAIN)         */
+        VS_SEGMENTS,            /* segmented extractions              */
+        VS_DELTA,               /* delta extractions                  */
+        VS_PQ_NEXT,             /* priority‑queue bucket scans        */
+        VS_PQ_SKIP,             /* ... empty buckets passed over      */
+        VS_NR_CTR
+};
+
+enum vmsort_hist {
+        VH_FAULT,               /* whole vmsort_fault                 */
+        VH_SCAN,                /* extraction: bitmap walk            */
+        VH_COPY,                /* extraction: copy_to_user           */
+        VH_SNAP,                /* snapshot / epoch flip              */
+        VH_NR_HIST
+};
+
+#define VMSORT_HIST_BUCKETS 32  /* bucket i: [2^i, 2^(i+1)) ns        */
+
+struct vmsort_stats {
+        u64 ctr[VS_NR_CTR];
+        u64 hist[VH_NR_HIST][VMSORT_HIST_BUCKETS];
+};
+
+static const char *const vmsort_ctr_names[VS_NR_CTR] = {
+        [VS_FAULT]          = "faults",
+        [VS_FAULT_NULL]     = "faults_null",
+        [VS_ALLOC_HUGE]     = "alloc_huge",
+        [VS_ALLOC_FALLBACK] = "alloc_fallback",
+        [VS_ALLOC_FAIL]     = "alloc_fail",
+        [VS_ALLOC_LOST]     = "alloc_lost",
+        [VS_BM_NEW]         = "bm_set_new",
+        [VS_BM_DUP]         = "bm_set_dup",
+        [VS_EXTRACT]        = "extracts",
+        [VS_EXTRACT_KEYS]   = "extract_keys",
+        [VS_SNAPSHOT]       = "snapshots",
+        [VS_EPOCH]          = "epochs",
+        [VS_SETOP]          = "setops",
+        [VS_ENCODE]         = "encodes",
+        [VS_ENCODE_BYTES]   = "encode_bytes",
+        [VS_PIN]            = "pins",
+        [VS_PIN_EXTRACT]    = "pin_extracts",
+        [VS_READ]           = "reads",
+        [VS_READ_SEEK]      = "read_seeks",
+        [VS_SAVE]           = "saves",
+        [VS_RESTORE]        = "restores",
+        [VS_CHUNK_RECLAIM]  = "chunk_reclaim",
+        [VS_CHUNK_REALLOC]  = "chunk_realloc",
+        [VS_DEGRADE_SMALL]  = "degrade_small",
+        [VS_DEGRADE_SINK]   = "degrade_sink",
+        [VS_PREPARE]        = "prepares",
+        [VS_URING]          = "uring_cmds",
+        [VS_URING_PUNT]     = "uring_punts",
+        [VS_SEGMENTS]       = "segment_extracts",
+        [VS_DELTA]          = "delta_extracts",
+        [VS_PQ_NEXT]        = "pq_next",
+        [VS_PQ_SKIP]        = "pq_skipped",
+};
+
+static const char *const vmsort_hist_names[VH_NR_HIST] = {
+        [VH_FAULT] = "fault_ns",
+        [VH_SCAN]  = "scan_ns",
+        [VH_COPY]  = "copy_ns",
+        [VH_SNAP]  = "snap_ns",
+};
+
+static inline unsigned vmsort_hist_bucket(u64 ns)
+{
+        unsigned b = ns ? ilog2(ns) : 0;
+        return b < VMSORT_HIST_BUCKETS ? b : VMSORT_HIST_BUCKETS - 1;
+}
+
+/* sum all CPUs of @pcpu into @sum */
+static inline void vmsort_stats_fold(struct vmsort_stats __percpu *pcpu,
+                                     struct vmsort_stats *sum)
+{
+        int cpu, i, j;
+
+        memset(sum, 0, sizeof(*sum));
+        for_each_possible_cpu(cpu) {
+                struct vmsort_stats *c = per_cpu_ptr(pcpu, cpu);
+                for (i = 0; i < VS_NR_CTR; ++i)
+                        sum->ctr[i] += c->ctr[i];
+                for (i = 0; i < VH_NR_HIST; ++i)
+                        for (j = 0; j < VMSORT_HIST_BUCKETS; ++j)
+                                sum->hist[i][j] += c->hist[i][j];
+        }
+}
+
+/* "key: value" lines, histograms as "name: b0 b1 ... bN" (trailing 0s cut) */
+static inline void vmsort_stats_show(struct seq_file *m,
+                                     const struct vmsort_stats *s)
+{
+        int i, j, last;
+
+        for (i = 0; i < VS_NR_CTR; ++i)
+                seq_printf(m, "%s:\t%llu\n", vmsort_ctr_names[i], s->ctr[i]);
+        for (i = 0; i < VH_NR_HIST; ++i) {
+                for (last = VMSORT_HIST_BUCKETS - 1; last > 0; --last)
+                        if (s->hist[i][last])
+                                break;
+                seq_printf(m, "%s:\t", vmsort_hist_names[i]);
+                for (j = 0; j <= last; ++j)
+                        seq_printf(m, "%llu%c", s->hist[i][j],
+                                   j == last ? '\n' : ' ');
+        }
+}
+
+#endif /* VMSORT_STATS_H_ */
@@ -0,0 +1,91 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vmsort
+
+#if !defined(VMSORT_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define VMSORT_TRACE_H_
+
+#include <linux/timekeeping.h>
+#include <linux/tracepoint.h>
+
+/* one per vmsort_fault: key, its chunk, and the chunk allocation if any */
+TRACE_EVENT(vmsort_fault,
+        TP_PROTO(u16 key, unsigned chunk, bool alloc, int order),
+        TP_ARGS(key, chunk, alloc, order),
+
+        TP_STRUCT__entry(
+                __field(u16,      key)
+                __field(unsigned, chunk)
+                __field(bool,     alloc)
+                __field(int,      order)
+        ),
+
+        TP_fast_assign(
+                __entry->key   = key;
+                __entry->chunk = chunk;
+                __entry->alloc = alloc;
+                __entry->order = order;
+        ),
+
+        TP_printk("key=%u chunk=%u alloc=%d order=%d",
+                  __entry->key, __entry->chunk, __entry->alloc,
+                  __entry->order)
+);
+
+/*
+ * chunk allocator outcome: order -1 means both attempts failed,
+ * won=0 means a racing fault installed its chunk first.  t0 is the
+ * start time, taken only while the event is enabled (0 otherwise, so
+ * an event enabled mid‑allocation reports ns=0); the end time is read
+ * here, so a disabled event costs no clock reads.
+ */
+TRACE_EVENT(vmsort_chunk_alloc,
+        TP_PROTO(unsigned chunk, int order, bool won, u64 t0),
+        TP_ARGS(chunk, order, won, t0),
+
+        TP_STRUCT__entry(
+                __field(unsigned, chunk)
+                __field(int,      order)
+                __field(bool,     won)
+                __field(u64,      ns)
+        ),
+
+        TP_fast_assign(
+                __entry->chunk = chunk;
+                __entry->order = order;
+                __entry->won   = won;
+                __entry->ns    = t0 ? ktime_get_ns() - t0 : 0;
+        ),
+
+        TP_printk("chunk=%u order=%d won=%d ns=%llu",
+                  __entry->chunk, __entry->order, __entry->won,
+                  __entry->ns)
+);
+
+/* one per extraction ioctl */
+TRACE_EVENT(vmsort_extract,
+        TP_PROTO(u32 keys, u64 bytes, u32 words),
+        TP_ARGS(keys, bytes, words),
+
+        TP_STRUCT__entry(
+                __field(u32, keys)
+                __field(u64, bytes)
+                __field(u32, words)
+        ),
+
+        TP_fast_assign(
+                __entry->keys  = keys;
+                __entry->bytes = bytes;
+                __entry->words = words;
+        ),
+
+        TP_printk("keys=%u bytes=%llu words=%u",
+                  __entry->keys, __entry->bytes, __entry->words)
+);
+
+#endif /* VMSORT_TRACE_H_ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE vmsort_trace
+#include <trace/define_trace.h>
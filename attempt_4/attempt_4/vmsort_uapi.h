@@ -0,0 +1,227 @@
+#ifndef VMSORT_UAPI_H_
+#define VMSORT_UAPI_H_
+
+/* shared by vmsort.c and the userspace tools */
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* whole‑set extraction: up to cap sorted keys into ptr, count in out */
+struct vmsort_iter { __u64 ptr; __u32 cap; __u32 out; };
+
+/* key range [lo, hi), lo < hi <= 65536 */
+struct vmsort_range {
+        __u64 ptr;              /* u16 output (RANGE only)          */
+        __u32 lo, hi;
+        __u32 cap;              /* RANGE: output capacity           */
+        __u32 out;              /* keys in range / keys written     */
+};
+
+/*
+ * point‑in‑time snapshot: SNAPSHOT freezes the current key set as
+ * generation gen (and extracts it if ptr != 0); SNAP_READ extracts the
+ * latest snapshot without taking a new one.  Faults never wait on either.
+ */
+struct vmsort_snap {
+        __u64 ptr;              /* u16 output, may be 0 for SNAPSHOT */
+        __u32 cap;
+        __u32 out;              /* keys written                      */
+        __u64 gen;              /* snapshot generation, 0 = none     */
+        __u64 keys;             /* total keys in the snapshot        */
+};
+
+/*
+ * set algebra over sessions: result = srcs[0] op srcs[1] op ... (left to
+ * right).  With VMSORT_SET_STORE the result replaces the key set of the
+ * session the ioctl is issued on: keys it drops have their pages
+ * unmapped (in 64‑key blocks, from the mapping process, like RESET), so
+ * touching them again re‑inserts them; keys it adds are present without
+ * a fault, and their page contents are not changed.  -ENXIO if issued
+ * from a process that does not map the session.  With ptr != 0 the
+ * result is also extracted.  card is always returned.
+ */
+#define VMSORT_SET_AND      0
+#define VMSORT_SET_OR       1
+#define VMSORT_SET_ANDNOT   2           /* srcs[0] minus all the others */
+#define VMSORT_SET_XOR      3
+#define VMSORT_SET_STORE    (1U << 0)
+#define VMSORT_SETOP_MAX    16
+
+struct vmsort_setop {
+        __u64 srcs;             /* user __s32[nsrc] of vmsort fds   */
+        __u32 nsrc;             /* 1..VMSORT_SETOP_MAX              */
+        __u32 op;
+        __u32 flags;
+        __u32 cap;
+        __u64 ptr;              /* u16 output, may be 0             */
+        __u64 card;             /* keys in the result               */
+        __u32 out;              /* keys written to ptr              */
+        __u32 pad;
+};
+
+/*
+ * encoded extraction: ptr receives a vmsort_enc_hdr and then the payload
+ *   U16     keys as __u16[keys]
+ *   VARINT  gap = key - prev - 1 (prev = -1 at start), LEB128 per gap
+ *   EF      Elias‑Fano, l = hdr.param low bits: __u64 low[ceil(keys*l/64)]
+ *           then __u64 high[ceil((keys + (65536 >> l))/64)], key i sets
+ *           high bit (key >> l) + i
+ *   RUNS    (__u16 first, __u16 length - 1) per maximal run
+ *   BITMAP  the raw 65536‑bit set, __u64[1024]
+ * AUTO picks the smallest for the current set.  Little‑endian.
+ */
+#define VMSORT_FMT_U16      0
+#define VMSORT_FMT_VARINT   1
+#define VMSORT_FMT_EF       2
+#define VMSORT_FMT_RUNS     3
+#define VMSORT_FMT_BITMAP   4
+#define VMSORT_FMT_NR       5
+#define VMSORT_FMT_AUTO     0xff
+
+struct vmsort_enc_hdr { __u8 fmt, param; __u16 rsv; __u32 keys; };
+
+struct vmsort_enc {
+        __u64 ptr;              /* output                           */
+        __u32 cap;              /* bytes available at ptr           */
+        __u32 fmt;              /* in: VMSORT_FMT_*, out: chosen    */
+        __u32 keys;             /* keys encoded                     */
+        __u32 bytes;            /* bytes written (-ENOSPC: needed)  */
+};
+
+/*
+ * pinned output: PIN pins cap u16 slots at ptr (cap <= 65536, ptr 2‑byte
+ * aligned) for the life of the session, replacing any earlier buffer;
+ * ptr = 0 unpins.  PIN_READ then decodes [lo, hi) straight into the
+ * pinned buffer at key offset ptr, up to cap keys, and returns only out.
+ */
+struct vmsort_pin {
+        __u64 ptr;
+        __u32 cap;
+        __u32 pages;            /* out: pages pinned                */
+};
+
+/*
+ * session image for warm restarts: SAVE serializes the live key set,
+ * RESTORE loads it into a freshly mapped, empty session with no faults.
+ * Layout: vmsort_image_hdr, __u64 l1[16], __u64 l0[blocks] (the non‑zero
+ * l0 words in l1 order), then with VMSORT_IMG_COUNTS __u64 counts[keys],
+ * the first word of each key's page (see vms_counter) in key order.
+ * Counts need a page per key: on a degraded session (an order‑0 chunk,
+ * or any fault mapped to the sink since the last RESET) both SAVE and
+ * RESTORE with VMSORT_IMG_COUNTS fail with -EOPNOTSUPP.
+ */
+#define VMSORT_IMG_MAGIC    0x766d7331U /* "vms1" */
+#define VMSORT_IMG_COUNTS   (1U << 0)
+
+struct vmsort_image_hdr {
+        __u32 magic;
+        __u32 flags;
+        __u32 keys;
+        __u32 blocks;           /* populated l0 words               */
+};
+
+struct vmsort_image {
+        __u64 ptr;
+        __u32 cap;              /* SAVE: room at ptr, RESTORE: length */
+        __u32 flags;            /* SAVE: VMSORT_IMG_*                 */
+        __u32 bytes;            /* SAVE: written (-ENOSPC: needed)    */
+        __u32 keys;
+};
+
+/*
+ * per‑session memory budget for backing chunks; 0 = unlimited (default:
+ * the budget_mb module parameter).  Past it, faults fall back to single
+ * pages and then to a per‑session sink page: they never fail and the key
+ * set stays exact, only page contents (vms_counter) are lost.
+ */
+struct vmsort_budget {
+        __u64 bytes;            /* in: new budget                   */
+        __u64 used;             /* out: bytes of chunks held        */
+};
+
+/*
+ * io_uring passthrough (IORING_OP_URING_CMD): sqe->cmd_op is one of the
+ * ops below and sqe->cmd holds a vmsort_uring_cmd; the result is the
+ * CQE res.  INSERT adds __u16 keys[len] at addr to the live set without
+ * faulting (res = keys new to the set); EXTRACT writes up to len sorted
+ * keys to addr (res = count); COUNT returns the set size; RESET empties
+ * the session (issue from the mapping process).  EXTRACT and RESET run
+ * on an io‑wq worker, never on the submitting thread.
+ */
+#define VMSORT_URING_INSERT  1
+#define VMSORT_URING_EXTRACT 2
+#define VMSORT_URING_COUNT   3
+#define VMSORT_URING_RESET   4
+
+struct vmsort_uring_cmd {       /* fits the 16‑byte cmd of a 64‑byte SQE */
+        __u64 addr;
+        __u32 len;
+        __u32 flags;            /* must be 0                        */
+};
+
+/*
+ * segmented sort: the key space is cut into 65536 >> shift segments of
+ * 1 << shift keys, segment i owning keys [i << shift, (i + 1) << shift)
+ * (insert local key k of segment i at page i << shift | k).  SEGMENTS
+ * extracts every segment at once: ptr receives the local keys of all
+ * segments back to back, offs the __u32[(65536 >> shift) + 1] start
+ * of each segment in ptr (last entry = out).  If cap is too small,
+ * nothing is written and out is the keys needed (-ENOSPC).  With
+ * VMSORT_SEG_RESET the session is then emptied as by the RESET uring
+ * op, ready for the next batch of segments.
+ */
+#define VMSORT_SEG_RESET    (1U << 0)
+
+struct vmsort_seg {
+        __u64 ptr;              /* __u16 local keys                 */
+        __u64 offs;             /* __u32 segment offsets            */
+        __u32 shift;            /* 0..16                            */
+        __u32 cap;              /* keys available at ptr            */
+        __u32 flags;            /* VMSORT_SEG_*                     */
+        __u32 out;              /* keys written (-ENOSPC: needed)   */
+};
+
+/*
+ * bucket priority queue: a key is a priority and its page the bucket,
+ * whose first __u64 (see vms_counter) is the number of entries in it.
+ * PQ_NEXT writes to ptr up to cap (<= 1024) keys >= from whose bucket
+ * is non‑empty, ascending; keys with an empty bucket are skipped, so
+ * emptied buckets stay mapped and cost nothing to refill.
+ */
+struct vmsort_pq {
+        __u64 ptr;              /* __u16 keys out                   */
+        __u32 from;
+        __u32 cap;
+        __u32 out;              /* keys written                     */
+        __u32 skipped;          /* empty buckets passed over        */
+};
+
+#define VMSORT_IOCTL        _IOWR('v', 1, struct vmsort_iter)
+#define VMSORT_IOC_COUNT    _IOWR('v', 2, struct vmsort_range)
+#define VMSORT_IOC_RANGE    _IOWR('v', 3, struct vmsort_range)
+#define VMSORT_IOC_SNAPSHOT _IOWR('v', 4, struct vmsort_snap)
+#define VMSORT_IOC_SNAP_READ _IOWR('v', 5, struct vmsort_snap)
+/* epoch mode: start a new epoch, extract and clear the previous one
+   (gen = epochs so far, keys = size of the returned epoch; keys beyond
+   cap are dropped) */
+#define VMSORT_IOC_EPOCH_FLIP _IOWR('v', 6, struct vmsort_snap)
+#define VMSORT_IOC_SETOP    _IOWR('v', 7, struct vmsort_setop)
+#define VMSORT_IOC_ENCODE   _IOWR('v', 8, struct vmsort_enc)
+#define VMSORT_IOC_PIN      _IOWR('v', 9, struct vmsort_pin)
+#define VMSORT_IOC_PIN_READ _IOWR('v', 10, struct vmsort_range)
+#define VMSORT_IOC_SAVE     _IOWR('v', 11, struct vmsort_image)
+#define VMSORT_IOC_RESTORE  _IOWR('v', 12, struct vmsort_image)
+#define VMSORT_IOC_BUDGET   _IOWR('v', 13, struct vmsort_budget)
+/* build every page‑table level of the window, no leaf PTEs, so faults
+   only fill leaves; from the mapping process */
+#define VMSORT_IOC_PREPARE  _IO('v', 14)
+#define VMSORT_IOC_SEGMENTS _IOWR('v', 15, struct vmsort_seg)
+/* only the keys new to the live set since the last DELTA (faults and
+   INSERT; not RESTORE or SETOP), sorted, up to cap; the rest stay
+   pending for the next call */
+#define VMSORT_IOC_DELTA    _IOWR('v', 16, struct vmsort_iter)
+#define VMSORT_IOC_PQ_NEXT  _IOWR('v', 17, struct vmsort_pq)
+/* RANGE in descending order: the cap largest keys of [lo, hi), so
+   top‑N is (0, 65536, N) and bottom‑N is plain RANGE */
+#define VMSORT_IOC_RANGE_DESC _IOWR('v', 18, struct vmsort_range)
+
+#endif /* VMSORT_UAPI_H_ */